@@ -5,7 +5,7 @@ import glob
 
 files = glob.glob("logs/*.csv")
 df = pd.concat([pd.read_csv(f, sep=',') for f in files])
-df = df[df['phase'].isin(['collision_sdf', 'collision_tri_brute'])]
+df = df[df['phase'].isin(['collision_sdf', 'collision_tri_brute', 'collision_tri_bvh'])]
 df = df[df['particle_count'] == 30000]    # fix N
 df = df[df['frame'] >= 100] #filter early frames out
 
@@ -16,6 +16,7 @@ summary['elapsed_ms'] = summary['mean'] / 1000
 
 sdf_data = summary[summary['phase'] == 'collision_sdf'].sort_values('collider_count')
 tri_data = summary[summary['phase'] == 'collision_tri_brute'].sort_values('collider_count')
+bvh_data = summary[summary['phase'] == 'collision_tri_bvh'].sort_values('collider_count')
 
 print(summary)
 
@@ -75,6 +76,18 @@ ax.errorbar(sdf_data['collider_count'], sdf_data['elapsed_ms'],
             label='SDF Collisions',
             capsize=3)
 
+if not bvh_data.empty:
+    ax.plot(bvh_data['collider_count'], bvh_data['elapsed_ms'],
+            linewidth = 3,
+            color = "#E3A650"
+            )
+    ax.errorbar(bvh_data['collider_count'], bvh_data['elapsed_ms'],
+                yerr=bvh_data['std'] / 1000,
+                linewidth=1.5,
+                color="#E3A650",
+                label='Triangle BVH Collisions',
+                capsize=3)
+
 x = np.array([1, 45])
 y_linear = x * (tri_data['elapsed_ms'].iloc[0] / tri_data['collider_count'].iloc[0])
 
@@ -85,7 +98,7 @@ ax.set_xlim(left=1)
 ax.legend(
     loc = 'upper center',
     bbox_to_anchor = (0.5, 1.15),
-    ncol = 3,
+    ncol = 2,
     frameon = False
     )
 
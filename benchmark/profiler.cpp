@@ -7,4 +7,5 @@ int Profiler::numParticles_ = 0;
 int Profiler::numFrames_ = 0;
 int Profiler::numColliders_ = 0;
 std::vector<TimeCouple> Profiler::timerManager_;
+std::vector<MetricSample> Profiler::metrics_;
 std::mutex Profiler::mtx;
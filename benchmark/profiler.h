@@ -6,6 +6,7 @@
 #include <mutex>
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 
 enum Phase {
   GRAVITY_PREDICT,
@@ -16,12 +17,42 @@ enum Phase {
   VISCOSITY,
   VORTICITY,
   COLLISION_SDF,
-  COLLISION_TRI_BRUTE
+  COLLISION_TRI_BRUTE,
+  REORDER,
+  PAIR_CACHE,
+  COLLISION_TRI_BVH
 };
 
 static const char *EnumToString[] = {
   "gravity_predict", "build_grid", "build_neighbours", "solver",
-  "velocity_update", "viscosity", "vorticity", "collision_sdf", "collision_tri_brute"
+  "velocity_update", "viscosity", "vorticity", "collision_sdf", "collision_tri_brute",
+  "reorder", "pair_cache", "collision_tri_bvh"
+};
+
+// Per-frame values that are not timings (memory, counters, tuning state).
+// Written to a separate CSV under logs/metrics/ so the timing plots are
+// unaffected.
+enum Metric {
+  NEIGHBOUR_BYTES,
+  NEIGHBOUR_PAIRS,
+  NEIGHBOUR_REBUILD,
+  REBUILD_RATE,
+  SKIN_RADIUS,
+  PAIR_CACHE_BYTES,
+  COLLISION_SKIP_RATE,
+  PENETRATION_DEPTH
+};
+
+static const char *MetricToString[] = {
+  "neighbour_bytes", "neighbour_pairs", "neighbour_rebuild", "rebuild_rate",
+  "skin_radius", "pair_cache_bytes", "collision_skip_rate",
+  "penetration_depth"
+};
+
+struct MetricSample {
+  Metric metric;
+  unsigned int frame;
+  double value;
 };
 
 struct TimeCouple {
@@ -38,6 +69,12 @@ class Profiler {
   Profiler(const Profiler&) = delete;
   static Profiler &Get() { return instance_; }
   static std::vector<TimeCouple> &GetTimerManager() { return timerManager_; }
+  static void Record(Metric metric, unsigned int frame, double value, bool isBenchmarking) {
+    if (!isBenchmarking) return;
+    Profiler::mtx.lock();
+    metrics_.push_back(MetricSample{metric, frame, value});
+    Profiler::mtx.unlock();
+  }
   static void Init(const std::string &filepath, const int numParticles, const int numColliders,
 		   const int numFrames, const std::string backend, const std::string commit) {
     filepath_ = filepath;
@@ -62,6 +99,19 @@ class Profiler {
 	.count()
 	  << std::endl;
     }
+
+    if (!metrics_.empty()) {
+      std::filesystem::path path(filepath_);
+      std::filesystem::path metricsDir = path.parent_path() / "metrics";
+      std::filesystem::create_directories(metricsDir);
+      std::ofstream metricsOut((metricsDir / path.filename()).string().c_str());
+      metricsOut << "commit,backend,particle_count,collider_count,metric,frame,value" << std::endl;
+      for (const MetricSample &sample : metrics_) {
+        metricsOut << commit_ << "," << backend_ << "," << numParticles_ << ","
+                   << numColliders_ << "," << MetricToString[sample.metric] << ","
+                   << sample.frame << "," << sample.value << std::endl;
+      }
+    }
     std::cout << "printed" << std::endl;
   }
   
@@ -75,6 +125,7 @@ class Profiler {
   static std::string backend_;
   static std::string commit_;
   static std::vector<TimeCouple> timerManager_; 
+  static std::vector<MetricSample> metrics_;
 
 };
 
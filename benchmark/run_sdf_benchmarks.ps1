@@ -42,3 +42,11 @@ foreach($N in $particleCounts) {
     Write-Host "Completed in $($elapsed.TotalSeconds)s"
   }
 }
+
+foreach ($quantity in $colliderCounts) {
+  for ($run = 1; $run -le $runs; $run++){
+    Write-Host "Running benchmark: $backend - $quantity colliders | bvh"
+    $elapsed = Measure-Command { & ".\build\Release\fluid-sim.exe" --benchmark -c $COMMIT -b $backend -p 30000 -f 500 -sdf $quantity -collision bvh -r $run}
+    Write-Host "Completed in $($elapsed.TotalSeconds)s"
+  }
+}
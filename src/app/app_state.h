@@ -3,18 +3,23 @@
 #include "input_state.h"
 #include "simulation_control.h"
 #include "viewport.h"
+#include "render_stats.h"
 #include "objects3d/editor_state.h"
 
 #ifdef USE_CUDA
 #include "../cuda_buffers.cuh"
 #endif
 
+class SimThread;
+
 struct AppState {
   Camera            *camera;
   InputState        *inputState;
   SimulationControl *simulationControl;
   Viewport          *viewport;
   EditorState *editorState;
+  SimThread   *simThread = nullptr;
+  RenderStats  renderStats;
 #ifdef USE_CUDA
   CudaBuffers* cudaBuffers;
 #endif
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// What the last frame's particle draw cost; written by Render, shown by the HUD
+struct RenderStats {
+  size_t instanceBytes       = 0;      // written to the instance ring
+  bool   persistentInstances = false;  // ring mapped once rather than per frame
+  int    instanceStalls      = 0;      // ring waits on the GPU so far
+  int    drawnParticles      = 0;      // drawn one instance each
+  int    splatCells          = 0;      // far cells drawn as one splat each
+  int    culledParticles     = 0;      // outside the frustum, not uploaded
+  int    culledCells         = 0;
+  // GPU side of the particle draws, a few frames old
+  double   particlePassMs  = 0.0;
+  uint64_t particleSamples = 0;      // fragments that passed the depth test
+  uint64_t particleShaded  = 0;      // fragment shader invocations, if counted
+  bool     shadedCounted   = false;  // GL_ARB_pipeline_statistics_query present
+  uint64_t framePixels     = 0;
+};
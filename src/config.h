@@ -21,6 +21,7 @@
 #include "particle_mesh.h"
 #include "linear_algebra.h"
 #include "particles.h"
+#include "sim_thread.h"
 #include "app/app_state.h"
 #include "app/scene_manager.h"
 #include "systems/camera_system.h"
@@ -31,6 +32,9 @@
 #include "systems/raycasting_system.h"
 #include "objects3d/object_builder.h"
 #include "objects3d/sdf_collision.h"
+#include "objects3d/sdf_volume.h"
+#include "objects3d/triangle_bvh.h"
+#include "objects3d/mesh_sdf.h"
 #include "objects3d/object_renderer.h"
 #include "helpers.h"
 #include "geometry.h"
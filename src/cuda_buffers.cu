@@ -1,6 +1,8 @@
 #include "cuda_buffers.cuh"
 #include "particles.h"
 
+#include <algorithm>
+
 CudaBuffers::CudaBuffers(Particles& particles) {
   size_t size = particles.numParticles * sizeof(Vec3);
   int numCells =
@@ -28,6 +30,7 @@ CudaBuffers::CudaBuffers(Particles& particles) {
 			  sizeof(float) * particles.activeParticles));
   HANDLE_ERROR(cudaMalloc((void **)&deltas_d, sizeof(Vec3) * particles.activeParticles));
   HANDLE_ERROR(cudaMalloc((void **)&colliders_d, sizeof(SDFCollider) * MAX_OBJECTS));
+  colliderCapacity = MAX_OBJECTS;
   HANDLE_ERROR(cudaMalloc((void **)&vorticities_d,
                           sizeof(Vec3) * particles.activeParticles));
   HANDLE_ERROR(
@@ -59,6 +62,14 @@ CudaBuffers::CudaBuffers(Particles& particles) {
   // 			  cudaMemcpyHostToDevice));
 }
 
+void CudaBuffers::ReserveColliders(size_t count) {
+  if (count <= colliderCapacity)
+    return;
+  colliderCapacity = std::max(count, colliderCapacity * 2);
+  HANDLE_ERROR(cudaFree(colliders_d));
+  HANDLE_ERROR(cudaMalloc((void **)&colliders_d, sizeof(SDFCollider) * colliderCapacity));
+}
+
 CudaBuffers::~CudaBuffers() {
   HANDLE_ERROR(cudaFree(positions_d));
   HANDLE_ERROR(cudaFree(velocities_d));
@@ -35,6 +35,8 @@ public:
   CudaBuffers &operator=(const CudaBuffers &cb) = delete;
   ~CudaBuffers();
   void handleCellGridUpdate(int numCells1D);
+  // Grows colliders_d to hold count colliders; contents are not kept
+  void ReserveColliders(size_t count);
 
   Vec3 *positions_d;
   Vec3 *velocities_d;
@@ -50,6 +52,8 @@ public:
   Vec3 *deltas_d;
   Vec3* vorticities_d;
   SDFCollider *colliders_d;
+  size_t colliderCapacity = 0;
+  int colliderCount = 0;       // colliders_d entries the collision kernel reads
   TriCollider* triColliders_d;
   Vec3 *closestPoints_d;
 
@@ -0,0 +1,116 @@
+#include "instance_ring.h"
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Not in the GL 3.3 loader; fetched from the driver when it has them
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data,
+                                           GLbitfield flags);
+
+static BufferStorageProc LoadBufferStorage()
+{
+  static BufferStorageProc proc = [] {
+    bool supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4) ||
+                     glfwExtensionSupported("GL_ARB_buffer_storage");
+    return supported ? (BufferStorageProc)glfwGetProcAddress("glBufferStorage") : nullptr;
+  }();
+  return proc;
+}
+
+InstanceRing::~InstanceRing()
+{
+  Release();
+}
+
+void InstanceRing::Release()
+{
+  for (GLsync& fence : fences) {
+    if (fence) glDeleteSync(fence);
+    fence = nullptr;
+  }
+  if (buffer) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (mapped || mapping) glUnmapBuffer(GL_ARRAY_BUFFER);
+    glDeleteBuffers(1, &buffer);
+  }
+  buffer  = 0;
+  mapped  = nullptr;
+  mapping = false;
+}
+
+bool InstanceRing::Reserve(size_t bytes, bool persistent)
+{
+  BufferStorageProc bufferStorage = persistent ? LoadBufferStorage() : nullptr;
+  if (buffer && bytes <= regionBytes && (mapped != nullptr) == (bufferStorage != nullptr))
+    return false;
+
+  // grow geometrically so a trickler filling up does not recreate every frame
+  if (bytes > regionBytes)
+    regionBytes = std::max(bytes, regionBytes + regionBytes / 2);
+  Release();
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  const GLsizeiptr total = (GLsizeiptr)(regionBytes * INSTANCE_RING_FRAMES);
+  if (bufferStorage) {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    bufferStorage(GL_ARRAY_BUFFER, total, nullptr, flags);
+    mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags);
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, total, nullptr, GL_STREAM_DRAW);
+  }
+  region = 0;
+  return true;
+}
+
+size_t InstanceRing::Acquire()
+{
+  region = (region + 1) % INSTANCE_RING_FRAMES;
+  if (GLsync fence = fences[region]) {
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      ++stalls;
+      do {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_C(1000000000));
+      } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fences[region] = nullptr;
+  }
+  return region * regionBytes;
+}
+
+void* InstanceRing::Map(size_t bytes)
+{
+  const size_t offset = region * regionBytes;
+  if (mapped)
+    return mapped + offset;
+  // the fence in Acquire() already guarantees the GPU is done with the range
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  void* data = glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes,
+                                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                GL_MAP_INVALIDATE_RANGE_BIT);
+  mapping = data != nullptr;
+  return data;
+}
+
+void InstanceRing::Unmap()
+{
+  // a coherent persistent mapping is visible to later commands as is
+  if (!mapping) return;
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+  mapping = false;
+}
+
+void InstanceRing::Fence()
+{
+  if (fences[region]) glDeleteSync(fences[region]);
+  fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <glad/glad.h>
+
+constexpr int INSTANCE_RING_FRAMES = 3;   // regions in flight
+
+// Per-frame instance data in one GL buffer split into INSTANCE_RING_FRAMES
+// regions written round-robin. Each region is fenced after the draws that
+// read it, so the CPU only waits when it laps the GPU instead of the driver
+// syncing on every update. Mapped once, persistently, where glBufferStorage
+// exists (GL 4.4 / ARB_buffer_storage), otherwise mapped unsynchronized for
+// each frame's writes.
+class InstanceRing {
+public:
+  InstanceRing() = default;
+  ~InstanceRing();
+  InstanceRing(const InstanceRing&) = delete;
+  InstanceRing& operator=(const InstanceRing&) = delete;
+
+  // Grows every region to at least bytes, or switches the mapping mode;
+  // true if the buffer was recreated (contents and attribute bindings lost)
+  bool Reserve(size_t bytes, bool persistent);
+
+  // Moves to the next region, waiting until the GPU is done reading it;
+  // returns its offset into Buffer()
+  size_t Acquire();
+  // CPU pointer to the first bytes of the acquired region; Unmap() before
+  // drawing from it
+  void* Map(size_t bytes);
+  void  Unmap();
+  // After the draws that read the acquired region
+  void  Fence();
+
+  GLuint Buffer() const { return buffer; }
+  size_t RegionBytes() const { return regionBytes; }
+  bool   Persistent() const { return mapped != nullptr; }
+  int    Stalls() const { return stalls; }   // Acquire() calls that had to wait
+
+private:
+  void Release();
+
+  GLuint buffer      = 0;
+  size_t regionBytes = 0;
+  int    region      = 0;
+  GLsync fences[INSTANCE_RING_FRAMES] = {};
+  char*  mapped      = nullptr;   // whole buffer, persistent mapping only
+  bool   mapping     = false;     // per-frame mapping outstanding
+  int    stalls      = 0;
+};
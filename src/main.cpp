@@ -14,8 +14,10 @@ bool runGpu = false; // only used for benchmarks
 int currentFrame = 0;
 
 bool useTriangleCollisions = false;
+bool useTriangleBVH = false;
 std::vector<TriCollider> gTriColliders;
-std::vector<Vec3> objTriangles_h;
+TriangleBVH gTriBVH;
+std::vector<Vec3> objTriangles_h;   // local-space mesh shared by every TriCollider
 std::vector<Vec3> gClosestPoints;
 
 unsigned int MakeShader(const std::string &vertexFilepath, const std::string &fragmentFilepath);
@@ -33,43 +35,16 @@ static void glfwErrorCallback(int error, const char *description)
   fprintf(stderr, "GLFW Error %d: %s\n", error, description);
 }
 
-// use only for benchmarks
-std::vector<Vec3> LoadOBJTriangles(const std::string &path) {
-  tinyobj::attrib_t attrib;
-  float scale = 0.001f;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string err;
-  std::vector<Vec3> out;
-  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str());
-  if (!err.empty()) std::cerr << "TinyObjLoader: " << err << "\n";
-  if (!ret)
-    return {};
-
-  for (size_t s = 0; s < shapes.size(); s++) {
-    size_t index_offset = 0;
-    for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-      size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-
-      for (size_t v = 0; v < fv; v++) {
-	tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-	tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-	tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-	tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-        // Y/Z swap and scale
-        out.push_back(Vec3{vx * scale, vz * scale, vy * scale});
-      }
-      index_offset += fv;
-    }
-  }
-  return  out;
-}
-
 int main(int argc, char *argv[]) {
   if (argc >= 2) {
-    if (argc != 16)
+    if (argc < 16 || argc % 2 != 0)
       printf("Incorrect usage: ./fluid-sim --benchmark -c xyz123 -b gpu -p "
-             "10000 -f 2000 -sdf 10 -collision sdf -r 3\n");
+             "10000 -f 2000 -sdf 10 -collision sdf|meshsdf|tri|bvh -r 3 [-reorder 200] "
+             "[-skin auto|off|0.3] [-paircache 0|1] "
+             "[-kernels auto|scalar|avx2|avx512] [-solver gs|jacobi] "
+             "[-parallel pool|tbb|std] [-threads 0] [-grain 256] [-pin 0|1] "
+             "[-sdfres 64] [-sdfgrad analytic|fd] [-meshobj meshes/SChannel.obj] "
+             "[-meshres 96] [-buckets 0|1] [-collcache 0|1] [-collide every|last|step]\n");
     else {
       isBenchmarking = true;
       std::string commit = "";
@@ -94,6 +69,63 @@ int main(int argc, char *argv[]) {
           collisionType = argv[i + 1];
 	if (std::strcmp(argv[i], "-r") == 0)
           profilerRuns = std::stoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "-reorder") == 0)
+          reorderInterval = std::stoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "-skin") == 0) {
+          // auto: tuned at runtime, off: exact lists rebuilt every frame,
+          // otherwise a fixed skin as a fraction of the smoothing radius
+          if (std::strcmp(argv[i + 1], "off") == 0) {
+            verletLists = false;
+          } else if (std::strcmp(argv[i + 1], "auto") != 0) {
+            skinFraction = std::stof(argv[i + 1]);
+            skinAutoTune = false;
+          }
+        }
+        if (std::strcmp(argv[i], "-paircache") == 0)
+          usePairCache = std::stoi(argv[i + 1]) != 0;
+        if (std::strcmp(argv[i], "-solver") == 0)
+          jacobiSolver = std::strcmp(argv[i + 1], "jacobi") == 0;
+        if (std::strcmp(argv[i], "-parallel") == 0) {
+          // tbb and std are alternatives picked at build time by USE_TBB
+          if (std::strcmp(argv[i + 1], "tbb") == 0)
+            parallelBackend = ParallelBackend::TBB;
+          else if (std::strcmp(argv[i + 1], "std") == 0)
+            parallelBackend = ParallelBackend::STD;
+          else
+            parallelBackend = ParallelBackend::POOL;
+        }
+        if (std::strcmp(argv[i], "-threads") == 0)
+          poolThreads = std::stoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "-grain") == 0)
+          parallelGrain = std::max(1, std::stoi(argv[i + 1]));
+        if (std::strcmp(argv[i], "-pin") == 0)
+          pinThreads = std::stoi(argv[i + 1]) != 0;
+        if (std::strcmp(argv[i], "-sdfres") == 0)
+          sdfVolumeResolution = std::stoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "-meshobj") == 0)
+          meshColliderPath = argv[i + 1];
+        if (std::strcmp(argv[i], "-meshres") == 0)
+          meshSDFResolution = std::stoi(argv[i + 1]);
+        if (std::strcmp(argv[i], "-buckets") == 0)
+          bucketedColliders = std::stoi(argv[i + 1]) != 0;
+        if (std::strcmp(argv[i], "-collcache") == 0)
+          collisionCache = std::stoi(argv[i + 1]) != 0;
+        if (std::strcmp(argv[i], "-collide") == 0) {
+          if (std::strcmp(argv[i + 1], "last") == 0)
+            collisionSchedule = CollisionSchedule::LAST_ITERATION;
+          else if (std::strcmp(argv[i + 1], "step") == 0)
+            collisionSchedule = CollisionSchedule::END_OF_STEP;
+          else
+            collisionSchedule = CollisionSchedule::EVERY_ITERATION;
+        }
+        if (std::strcmp(argv[i], "-sdfgrad") == 0)
+          sdfGradientMode = std::strcmp(argv[i + 1], "fd") == 0 ? SDFGradient::FINITE_DIFFERENCE
+                                                                 : SDFGradient::ANALYTIC;
+        if (std::strcmp(argv[i], "-kernels") == 0 &&
+            !ParseKernelFamily(argv[i + 1], kernelFamily)) {
+          printf("Unknown kernel family: %s\n", argv[i + 1]);
+          return -1;
+        }
       }
       if (commit.empty() || backend.empty() || profilerParticles == -1 ||
           profilerFrames == -1 || profilerColliders == -1) {
@@ -107,7 +139,14 @@ int main(int argc, char *argv[]) {
 
       if (collisionType == "tri")
 	useTriangleCollisions = true;
+      if (collisionType == "bvh")
+        useTriangleCollisions = useTriangleBVH = true;
       std::cout << runParallel << std::endl;
+      std::cout << "solver kernels: "
+                << KernelFamilyName(ResolveKernelFamily(kernelFamily)) << std::endl;
+      if (usePairCache && ResolveKernelFamily(kernelFamily) != KernelFamily::SCALAR)
+        std::cout << "pair cache: inactive, the SIMD kernels take precedence "
+                     "(use -kernels scalar)" << std::endl;
       std::string filepath = "benchmark/logs/" + commit + "-" + backend + "-" + collisionType +  "-" +
 	std::to_string(profilerParticles) + "-" + std::to_string(profilerFrames) + "-" + std::to_string(profilerColliders) + "-" + std::to_string(profilerRuns) + ".csv";
       Profiler::Init(filepath, profilerParticles, profilerColliders, profilerFrames, backend,
@@ -116,34 +155,36 @@ int main(int argc, char *argv[]) {
       std::cout << "filepath: " << filepath << std::endl;
 
 
-      SDFCollider colliders[MAX_OBJECTS];
+      std::vector<SDFCollider> colliders(MAX_OBJECTS);
       GridState grid;
       AppState appState;
 
       Particles particles(profilerParticles, smoothingRadius);
 
-      std::vector<Vec3> triangles = LoadOBJTriangles("meshes/SChannel.obj");
-      size_t objTriCount = triangles.size();
+      // every collider instances the same mesh and hierarchy
+      objTriangles_h = LoadOBJTriangles("meshes/SChannel.obj");
+      size_t objTriCount = objTriangles_h.size();
+      if (useTriangleBVH)
+        gTriBVH.Build(objTriangles_h.data(), objTriCount);
 
 #ifdef USE_CUDA
       CudaBuffers cudaBuffers(particles);
       appState.cudaBuffers = &cudaBuffers;
 
       Vec3* objTriangles_d;
-      HANDLE_ERROR(cudaMalloc((void **)&objTriangles_d,
-                              objTriCount * sizeof(Vec3) * profilerColliders));
-#else
-      objTriangles_h.resize(objTriCount * profilerColliders);
+      HANDLE_ERROR(cudaMalloc((void **)&objTriangles_d, objTriCount * sizeof(Vec3)));
+      HANDLE_ERROR(cudaMemcpy(objTriangles_d, objTriangles_h.data(), objTriCount * sizeof(Vec3),
+                              cudaMemcpyHostToDevice));
 #endif
 
-
       int count = 0;
       for (int y = 4; y >= 0 && count < profilerColliders; --y) {
 	for (int z = 1; z <= 3 && count < profilerColliders; ++z) {
 	  for (int x = 1; x <= 3 && count < profilerColliders; ++x) {
 	    if (!useTriangleCollisions) {
 	      SDFCollider c;
-	      c.type = RGObjectType::S_CHANNEL;
+	      // meshsdf: the same S channel, baked from its OBJ instead of the analytic SDF
+	      c.type = collisionType == "meshsdf" ? RGObjectType::MESH : RGObjectType::S_CHANNEL;
 	      c.worldPosition = grid.CellCenterWorld(x, y, z);
               c.rotationAxes[0] = Vec3{1, 0, 0};
               c.rotationAxes[1] = Vec3{0, 1, 0};
@@ -154,22 +195,19 @@ int main(int argc, char *argv[]) {
 	      ++count;
 	    } else  {
               TriCollider tc;
-              Vec3 cellCenter = grid.CellCenterWorld(x, y, z);
-              std::vector<Vec3> currentObj;
-              currentObj.resize(objTriCount);
-              for (size_t i{}; i < objTriCount; ++i) {
-                currentObj[i] = triangles[i] + cellCenter;
-	      }
 #ifdef USE_CUDA
-              cudaMemcpy(&objTriangles_d[count * objTriCount], currentObj.data(), objTriCount * sizeof(Vec3),
-                         cudaMemcpyHostToDevice);
-	      tc.triangles = &objTriangles_d[count *objTriCount];
+	      tc.triangles = objTriangles_d;
 #else
-	      memcpy(&objTriangles_h[count * objTriCount], currentObj.data(), objTriCount * sizeof(Vec3));
-	      tc.triangles  =&objTriangles_h[count * objTriCount];
+	      tc.triangles = objTriangles_h.data();
 #endif
               tc.restitution = energyRetention;
 	      tc.count = objTriCount;
+              if (useTriangleBVH)
+                tc.bvh = &gTriBVH;
+              tc.worldPosition = grid.CellCenterWorld(x, y, z);
+              tc.rotationAxes[0] = Vec3{1, 0, 0};
+              tc.rotationAxes[1] = Vec3{0, 1, 0};
+              tc.rotationAxes[2] = Vec3{0, 0, 1};
               gTriColliders.push_back(tc);
 	      ++count;
             }
@@ -177,14 +215,20 @@ int main(int argc, char *argv[]) {
         }
       }
       gClosestPoints.resize(profilerParticles);
+      // bake before timing starts
+      EnsureSDFVolumes(sdfVolumeResolution, colliders.data(), (int)colliders.size());
 #ifdef USE_CUDA
+      HANDLE_ERROR(cudaMemcpy(cudaBuffers.colliders_d, colliders.data(),
+                              sizeof(SDFCollider) * colliders.size(), cudaMemcpyHostToDevice));
+      cudaBuffers.colliderCount = (int)colliders.size();
       HANDLE_ERROR(cudaMemcpy(cudaBuffers.triColliders_d, gTriColliders.data(),
                               sizeof(TriCollider) * profilerColliders,
                               cudaMemcpyHostToDevice));
 #endif
       for (int i = 0; i < profilerFrames; ++i) {
         particles.Update(1.0f / 60.0f, smoothingRadius, 2.0f, 640, 480,
-                         Vec3{0.0f, 0.0f, 0.0f}, Vec3{0.0f, 0.0f, 0.0f}, 0.0f,colliders, &appState);
+                         Vec3{0.0f, 0.0f, 0.0f}, Vec3{0.0f, 0.0f, 0.0f}, 0.0f, colliders.data(),
+                         (int)colliders.size(), &appState);
 	currentFrame++;
       }
 
@@ -280,6 +324,8 @@ int main(int argc, char *argv[]) {
   ParticleMesh particleMesh;
   unsigned int particleShader = MakeShader("src/shaders/vertex.glsl",
 					   "src/shaders/fragment.glsl");
+  unsigned int impostorShader = MakeShader("src/shaders/vertex.glsl",
+					   "src/shaders/impostor_fragment.glsl");
 
   std::vector<SceneObject> sceneObjects;
 
@@ -318,15 +364,17 @@ int main(int argc, char *argv[]) {
   float radiusPx;
   particles.Reset(smoothingRadius, &appState);
 
-  // Really really stupid. Get this fixed.
-  particleMesh.SetupInstanceBuffers(particles.numParticles); //TODO: refactor out
+  // From here on the particles belong to the simulation; the loop below only
+  // reads its snapshots and posts commands
+  SimThread sim(particles, editorState.colliders.Data(), editorState.colliders.Size(), &appState);
+  appState.simThread = &sim;
+  if (threadedSim)
+    sim.Start();
 
   double lastTime = glfwGetTime();
 
   float dtMeasured = 0.0f;
 
-  SDFCollider colliders[MAX_OBJECTS];
-
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
 
@@ -335,7 +383,8 @@ int main(int argc, char *argv[]) {
     lastTime = now;
     dtMeasured = std::min(dtMeasured, 1.0f / 60.0f);
 
-    DrawHUD(particles, simulationControl, editorState, &appState, dtMeasured);
+    const SimSnapshot& snapshot = sim.Latest();
+    DrawHUD(sim, snapshot, simulationControl, editorState, &appState, dtMeasured);
 
     radiusPx = radiusLogical * xScale;
 
@@ -343,10 +392,10 @@ int main(int argc, char *argv[]) {
 
 
     bool wasReset = simulationControl.isReset;
-    float dtToSim = HandleSimulationControl(simulationControl, dtMeasured, particles, &appState);
+    float dtToSim = HandleSimulationControl(simulationControl, dtMeasured, sim, &appState);
     if (wasReset) {
       if (editorState.resetObjectsOnR)
-        loadDefaultScene(editorState, &appState);
+        LoadDefaultScene(sim, editorState);
     }
     // std::vector<SDFCollider> testColliders;
     // BuildSDFColliders(editorState.objects, testColliders);
@@ -357,26 +406,31 @@ int main(int argc, char *argv[]) {
 
     MouseRay mouseRay = MouseRaycast(inputState, cameraState, window);
 
-    std::vector<Vec3> sdfPoints;
-    if (dtToSim > 0) {
-      //BuildSDFColliders(editorState.objects, colliders);
-      particles.Update(dtToSim, smoothingRadius, radiusPx, viewport.screenWidth,
-                       viewport.screenHeight, mouseRay.origin,
-                       mouseRay.direction, mouseRay.strength, editorState.colliders, &appState);
-
-    }
+    SimInputs simInputs;
+    simInputs.running        = !simulationControl.isPaused;
+    simInputs.radiusPx       = radiusPx;
+    simInputs.screenWidth    = viewport.screenWidth;
+    simInputs.screenHeight   = viewport.screenHeight;
+    simInputs.mouseOrigin    = mouseRay.origin;
+    simInputs.mouseDirection = mouseRay.direction;
+    simInputs.mouseStrength  = mouseRay.strength;
+    sim.SetInputs(simInputs);
+    // this frame's collider edits, as one batch ahead of the step
+    editorState.colliders.Flush(&appState);
+    if (!sim.Threaded())
+      sim.Tick(dtToSim);
 
     cellGridRef.visible = editorState.showGrid;
 
-    Render(cameraState, viewport, particles, particleMesh,
-	   particleShader, sceneObjects, radiusLogical, xScale, &appState);
+    Render(cameraState, viewport, snapshot, particleMesh,
+	   particleShader, impostorShader, sceneObjects, radiusLogical, xScale, &appState);
 
     // Render solid RG objects, optional ghost preview, and cell overlays
     {
       float aspect = (float)viewport.screenWidth / (float)viewport.screenHeight;
       Mat4 proj = Perspective(45.0f * PI / 180.0f, aspect, 0.1f, 100.0f);
       RenderObjects(objectRenderer, editorState.objects,
-                    editorState.previewActive ? editorState.previewObjects
+                    editorState.previewActive ? &editorState.previewObject
                                               : nullptr,
                     &editorState.grid, editorState.showSelectedCell,
                     editorState.showOccupiedOutlines, cameraState.view, proj,
@@ -389,7 +443,9 @@ int main(int argc, char *argv[]) {
 
     glfwSwapBuffers(window);
   }
+  sim.Stop();
   glDeleteProgram(particleShader);
+  glDeleteProgram(impostorShader);
   DestroyObjectRenderer(objectRenderer);
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
@@ -0,0 +1,100 @@
+#include "collider_broadphase.h"
+#include "sdf_volume.h"
+
+#include <algorithm>
+#include <cstring>
+
+static float Component(const Vec3& v, int axis)
+{
+  return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+bool ColliderBroadphase::Update(const SDFCollider* colliders, int count)
+{
+  changed.clear();
+  changedAll = cellStart.empty();
+  // removed slots only have to leave the lists
+  bool any = changedAll || count < (int)built.size();
+  const int kept = std::min(count, (int)built.size());
+  built.resize(count);
+  cells.resize(count);
+
+  for (int j = 0; j < count; ++j) {
+    if (!changedAll && j < kept &&
+        std::memcmp(&built[j], &colliders[j], sizeof(SDFCollider)) == 0)
+      continue;
+    built[j] = colliders[j];
+    BoundSlot(j, colliders[j]);
+    any = true;
+  }
+  if (any)
+    Build();
+  return any;
+}
+
+bool ColliderWorldBounds(const SDFCollider& c, Vec3& lo, Vec3& hi)
+{
+  Vec3 localLo, localHi;
+  if (!SDFShapeBounds(c.type, localLo, localHi)) return false;
+
+  Vec3 centre = (localLo + localHi) * 0.5f;
+  Vec3 half   = (localHi - localLo) * 0.5f;
+  Vec3 worldCentre = c.worldPosition + c.rotationAxes[0] * centre.x +
+                     c.rotationAxes[1] * centre.y + c.rotationAxes[2] * centre.z;
+  // world half extent of the rotated box along axis a
+  auto extentAlong = [&](int a) {
+    return std::fabs(Component(c.rotationAxes[0], a)) * half.x +
+           std::fabs(Component(c.rotationAxes[1], a)) * half.y +
+           std::fabs(Component(c.rotationAxes[2], a)) * half.z;
+  };
+  Vec3 extent{extentAlong(0), extentAlong(1), extentAlong(2)};
+  lo = worldCentre - extent;
+  hi = worldCentre + extent;
+  return true;
+}
+
+void ColliderBroadphase::BoundSlot(int j, const SDFCollider& collider)
+{
+  SlotCells& slot = cells[j];
+  slot.listed = false;
+  ColliderSlotBounds world;
+  world.valid = ColliderWorldBounds(collider, world.lo, world.hi);
+  if (!world.valid) return;
+  changed.push_back(world);
+
+  // cell range of the collider's world AABB
+  const int gridCells[3] = {BROADPHASE_X, BROADPHASE_Y, BROADPHASE_Z};
+  bool inside = true;
+  for (int a = 0; a < 3; ++a) {
+    slot.lo[a] = std::max(0, (int)std::floor((Component(world.lo, a) + 1.0f) / BROADPHASE_CELL));
+    slot.hi[a] = std::min(gridCells[a] - 1, (int)std::floor((Component(world.hi, a) + 1.0f) / BROADPHASE_CELL));
+    inside &= slot.lo[a] <= slot.hi[a];
+  }
+  slot.listed = inside;
+}
+
+void ColliderBroadphase::Build()
+{
+  const int numCells = BROADPHASE_X * BROADPHASE_Y * BROADPHASE_Z;
+
+  // count, scan, fill
+  cellStart.assign(numCells + 1, 0);
+  auto forEachCell = [&](int j, auto&& func) {
+    const SlotCells& slot = cells[j];
+    for (int z = slot.lo[2]; z <= slot.hi[2]; ++z)
+      for (int y = slot.lo[1]; y <= slot.hi[1]; ++y)
+        for (int x = slot.lo[0]; x <= slot.hi[0]; ++x)
+          func(x + y * BROADPHASE_X + z * BROADPHASE_X * BROADPHASE_Y);
+  };
+  for (int j = 0; j < (int)cells.size(); ++j)
+    if (cells[j].listed)
+      forEachCell(j, [&](int cell) { ++cellStart[cell + 1]; });
+  for (int cell = 0; cell < numCells; ++cell)
+    cellStart[cell + 1] += cellStart[cell];
+
+  items.resize(cellStart[numCells]);
+  std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+  for (int j = 0; j < (int)cells.size(); ++j)
+    if (cells[j].listed)
+      forEachCell(j, [&](int cell) { items[fill[cell]++] = j; });
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include "editor_state.h"
+#include "grid_state.h"
+
+// Broadphase cells per editor grid cell along each axis
+constexpr int   BROADPHASE_SUBDIV = 2;
+constexpr int   BROADPHASE_X      = GRID_X * BROADPHASE_SUBDIV;
+constexpr int   BROADPHASE_Y      = GRID_Y * BROADPHASE_SUBDIV;
+constexpr int   BROADPHASE_Z      = GRID_Z * BROADPHASE_SUBDIV;
+constexpr float BROADPHASE_CELL   = CELL_SIZE / BROADPHASE_SUBDIV;
+
+// World-space box around collider's shape; false for empty slots
+bool ColliderWorldBounds(const SDFCollider& collider, Vec3& lo, Vec3& hi);
+
+// A collider's world box, cached per slot so an edit only recomputes its own
+struct ColliderSlotBounds {
+  Vec3 lo{0.0f, 0.0f, 0.0f}, hi{0.0f, 0.0f, 0.0f};
+  bool valid = false;   // false: empty slot
+};
+
+// Uniform grid over the editor volume listing, per cell, the colliders whose
+// world bounds overlap it, in CSR form like the neighbour lists. A particle
+// only projects against its own cell's list instead of all MAX_OBJECTS
+// slots. Empty BOX slots are never listed, and colliders outside the
+// fluid domain never reach a cell.
+class ColliderBroadphase {
+public:
+  // Re-bounds the slots that differ from the last call (or were added) and
+  // relists the cells; true if any slot changed
+  bool Update(const SDFCollider* colliders, int count);
+
+  // World boxes of the colliders the last Update() added or moved. Only
+  // these can be closer than an old CollisionBound; empty slots need none.
+  // Everything changed when Update() ran for the first time.
+  const std::vector<ColliderSlotBounds>& ChangedBounds() const { return changed; }
+  bool ChangedAll() const { return changedAll; }
+
+  // Colliders near p as [begin, end) into the candidate list
+  void Candidates(const Vec3& p, const int*& begin, const int*& end) const {
+    int x = (int)std::floor((p.x + 1.0f) * (1.0f / BROADPHASE_CELL));
+    int y = (int)std::floor((p.y + 1.0f) * (1.0f / BROADPHASE_CELL));
+    int z = (int)std::floor((p.z + 1.0f) * (1.0f / BROADPHASE_CELL));
+    if (x < 0 || y < 0 || z < 0 || x >= BROADPHASE_X || y >= BROADPHASE_Y || z >= BROADPHASE_Z) {
+      begin = end = items.data();
+      return;
+    }
+    int cell = x + y * BROADPHASE_X + z * BROADPHASE_X * BROADPHASE_Y;
+    begin = items.data() + cellStart[cell];
+    end   = items.data() + cellStart[cell + 1];
+  }
+
+  // Distance from p to the outside of its cell: colliders not listed for
+  // the cell are at least this far away. 0 outside the grid.
+  float Clearance(const Vec3& p) const {
+    float fx = (p.x + 1.0f) * (1.0f / BROADPHASE_CELL);
+    float fy = (p.y + 1.0f) * (1.0f / BROADPHASE_CELL);
+    float fz = (p.z + 1.0f) * (1.0f / BROADPHASE_CELL);
+    if (!(fx >= 0.0f && fy >= 0.0f && fz >= 0.0f &&
+          fx < BROADPHASE_X && fy < BROADPHASE_Y && fz < BROADPHASE_Z))
+      return 0.0f;
+    auto faceDistance = [](float f) {
+      float t = f - std::floor(f);
+      return std::fmin(t, 1.0f - t) * BROADPHASE_CELL;
+    };
+    return std::fmin(faceDistance(fx), std::fmin(faceDistance(fy), faceDistance(fz)));
+  }
+
+  size_t EntryCount() const { return items.size(); }
+
+private:
+  // Cell range of one slot's world box
+  struct SlotCells {
+    int  lo[3] = {}, hi[3] = {};
+    bool listed = false;
+  };
+
+  void BoundSlot(int j, const SDFCollider& collider);
+  void Build();
+
+  std::vector<SDFCollider>        built;     // colliders the lists were built from
+  std::vector<SlotCells>          cells;     // per slot
+  std::vector<ColliderSlotBounds> changed;
+  bool                            changedAll = false;
+  std::vector<int>                cellStart; // size cells + 1
+  std::vector<int>                items;     // collider indices
+};
@@ -0,0 +1,236 @@
+#include "collider_buckets.h"
+#include "collider_broadphase.h"
+#include "sdf_collision.h"
+#include "sdf_volume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Analytic distance of one shape, fixed at compile time so the packet loop
+// calls it directly instead of going through sdfDispatch
+template<RGObjectType T> inline float ShapeDistance(const Vec3& p);
+template<> inline float ShapeDistance<RGObjectType::S_CHANNEL>(const Vec3& p) { return sdfSChannel(p); }
+template<> inline float ShapeDistance<RGObjectType::L_CHANNEL>(const Vec3& p) { return sdfLChannel(p); }
+template<> inline float ShapeDistance<RGObjectType::RAMP>(const Vec3& p)      { return sdfBRamp(p); }
+// baked only; without the volume there is nothing to collide with
+template<> inline float ShapeDistance<RGObjectType::MESH>(const Vec3&)        { return 1e9f; }
+
+// Positions of the packet's particles that need testing, one column per
+// component; lane i is particle lane[i] of the packet
+struct PacketColumns {
+  float x[COLLIDER_PACKET], y[COLLIDER_PACKET], z[COLLIDER_PACKET];
+  float bound[COLLIDER_PACKET];   // smallest collider distance bound so far
+  int   lane[COLLIDER_PACKET];
+  int   count = 0;
+  Vec3  lo, hi;
+};
+
+// Distance between two boxes, 0 when they overlap
+static float BoxGap(const Vec3& loA, const Vec3& hiA, const Vec3& loB, const Vec3& hiB)
+{
+  float dx = std::max(std::max(loB.x - hiA.x, loA.x - hiB.x), 0.0f);
+  float dy = std::max(std::max(loB.y - hiA.y, loA.y - hiB.y), 0.0f);
+  float dz = std::max(std::max(loB.z - hiA.z, loA.z - hiB.z), 0.0f);
+  return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+bool ColliderBuckets::Update(const SDFCollider* colliders, int count)
+{
+  const bool first = !updated;
+  updated = true;
+  bool any = first || count < (int)built.size();
+  const int kept = std::min(count, (int)built.size());
+  built.resize(count);
+  slotBounds.resize(count);
+
+  for (int j = 0; j < count; ++j) {
+    if (!first && j < kept &&
+        std::memcmp(&built[j], &colliders[j], sizeof(SDFCollider)) == 0)
+      continue;
+    built[j] = colliders[j];
+    ColliderSlotBounds& slot = slotBounds[j];
+    slot.valid = ColliderWorldBounds(colliders[j], slot.lo, slot.hi);
+    any = true;
+  }
+  if (any)
+    Build();
+  return any;
+}
+
+void ColliderBuckets::Build()
+{
+  buckets.clear();
+  for (int t = 0; t < RG_OBJECT_TYPES; ++t) {
+    ColliderBucket bucket;
+    bucket.type = (RGObjectType)t;
+    for (int j = 0; j < (int)built.size(); ++j) {
+      const SDFCollider& c = built[j];
+      if (c.type != bucket.type || !slotBounds[j].valid) continue;
+      const Vec3& lo = slotBounds[j].lo;
+      const Vec3& hi = slotBounds[j].hi;
+
+      bucket.index.push_back(j);
+      bucket.positionX.push_back(c.worldPosition.x);
+      bucket.positionY.push_back(c.worldPosition.y);
+      bucket.positionZ.push_back(c.worldPosition.z);
+      for (int a = 0; a < 3; ++a) {
+        bucket.axis[a][0].push_back(c.rotationAxes[a].x);
+        bucket.axis[a][1].push_back(c.rotationAxes[a].y);
+        bucket.axis[a][2].push_back(c.rotationAxes[a].z);
+      }
+      bucket.boundsLoX.push_back(lo.x);
+      bucket.boundsLoY.push_back(lo.y);
+      bucket.boundsLoZ.push_back(lo.z);
+      bucket.boundsHiX.push_back(hi.x);
+      bucket.boundsHiY.push_back(hi.y);
+      bucket.boundsHiZ.push_back(hi.z);
+    }
+    if (bucket.Size() > 0)
+      buckets.push_back(std::move(bucket));
+  }
+
+  order.clear();
+  for (int b = 0; b < (int)buckets.size(); ++b)
+    for (int k = 0; k < buckets[b].Size(); ++k)
+      order.push_back(ColliderSlot{b, k});
+  std::sort(order.begin(), order.end(), [&](const ColliderSlot& a, const ColliderSlot& c) {
+    return buckets[a.bucket].index[a.entry] < buckets[c.bucket].index[c.entry];
+  });
+}
+
+int ColliderBuckets::ColliderCount() const
+{
+  return (int)order.size();
+}
+
+template<RGObjectType T>
+static void ProjectCollider(const ColliderBucket& bucket, int k, const SDFCollider& collider,
+                            PacketColumns& packet, Vec3* positions, Vec3* velocities)
+{
+  const Vec3 boundsLo{bucket.boundsLoX[k], bucket.boundsLoY[k], bucket.boundsLoZ[k]};
+  const Vec3 boundsHi{bucket.boundsHiX[k], bucket.boundsHiY[k], bucket.boundsHiZ[k]};
+  const float gap = BoxGap(packet.lo, packet.hi, boundsLo, boundsHi);
+  if (gap > 0.0f) {
+    // no lane can be closer to the shape than the packet box is to its box
+    for (int i = 0; i < packet.count; ++i)
+      packet.bound[i] = std::min(packet.bound[i], gap);
+    return;
+  }
+
+  // a packet spans a few broadphase cells, so most of its particles can
+  // still be outside the box; only the ones inside run the distance
+  int inside[COLLIDER_PACKET];
+  int count = 0;
+  for (int i = 0; i < packet.count; ++i) {
+    float g = BoxGap(Vec3{packet.x[i], packet.y[i], packet.z[i]},
+                     Vec3{packet.x[i], packet.y[i], packet.z[i]}, boundsLo, boundsHi);
+    packet.bound[i] = std::min(packet.bound[i], g);
+    inside[count] = i;
+    count += g == 0.0f;
+  }
+  if (count == 0) return;
+
+  // into the collider's frame, same arithmetic as ProjectParticleSDF
+  float lx[COLLIDER_PACKET], ly[COLLIDER_PACKET], lz[COLLIDER_PACKET];
+  const float ox = bucket.positionX[k], oy = bucket.positionY[k], oz = bucket.positionZ[k];
+  const float a0x = bucket.axis[0][0][k], a0y = bucket.axis[0][1][k], a0z = bucket.axis[0][2][k];
+  const float a1x = bucket.axis[1][0][k], a1y = bucket.axis[1][1][k], a1z = bucket.axis[1][2][k];
+  const float a2x = bucket.axis[2][0][k], a2y = bucket.axis[2][1][k], a2z = bucket.axis[2][2][k];
+  for (int s = 0; s < count; ++s) {
+    const int i = inside[s];
+    float dx = packet.x[i] - ox, dy = packet.y[i] - oy, dz = packet.z[i] - oz;
+    lx[s] = dx * a0x + dy * a0y + dz * a0z;
+    ly[s] = dx * a1x + dy * a1y + dz * a1z;
+    lz[s] = dx * a2x + dy * a2y + dz * a2z;
+  }
+
+  float distance[COLLIDER_PACKET], bound[COLLIDER_PACKET];
+  bool any = false;
+  if (const SDFVolume* volume = BakedSDFVolume(T)) {
+    for (int s = 0; s < count; ++s) {
+      distance[s] = volume->Distance(Vec3{lx[s], ly[s], lz[s]});
+      any |= distance[s] < 0.0f;
+    }
+    for (int s = 0; s < count; ++s)
+      bound[s] = volume->DistanceBound(Vec3{lx[s], ly[s], lz[s]}, distance[s]);
+  } else {
+    // the CSG of exact distances is its own bound
+    for (int s = 0; s < count; ++s) {
+      distance[s] = ShapeDistance<T>(Vec3{lx[s], ly[s], lz[s]});
+      any |= distance[s] < 0.0f;
+      bound[s] = distance[s];
+    }
+  }
+  for (int s = 0; s < count; ++s)
+    packet.bound[inside[s]] = std::min(packet.bound[inside[s]], bound[s]);
+  if (!any) return;
+
+  for (int s = 0; s < count; ++s) {
+    if (distance[s] >= 0.0f) continue;
+    const int i = inside[s];
+    const int lane = packet.lane[i];
+    ResolveSDFPenetration(positions[lane], velocities[lane], collider, Vec3{lx[s], ly[s], lz[s]},
+                          distance[s]);
+    packet.x[i] = positions[lane].x;
+    packet.y[i] = positions[lane].y;
+    packet.z[i] = positions[lane].z;
+    // a push can leave the packet box; grow it so later colliders see it
+    packet.lo = Vec3{std::min(packet.lo.x, packet.x[i]), std::min(packet.lo.y, packet.y[i]),
+                     std::min(packet.lo.z, packet.z[i])};
+    packet.hi = Vec3{std::max(packet.hi.x, packet.x[i]), std::max(packet.hi.y, packet.y[i]),
+                     std::max(packet.hi.z, packet.z[i])};
+  }
+}
+
+int ColliderBuckets::ProjectPacket(Vec3* positions, Vec3* velocities, int count,
+                                   CollisionBound* bounds) const
+{
+  if (order.empty() || count <= 0) return 0;
+
+  // lanes still covered by their bound cannot reach a collider this pass
+  PacketColumns packet;
+  for (int i = 0; i < count; ++i) {
+    if (bounds && bounds[i].Covers(positions[i])) continue;
+    const int n = packet.count++;
+    packet.lane[n]  = i;
+    packet.x[n]     = positions[i].x;
+    packet.y[n]     = positions[i].y;
+    packet.z[n]     = positions[i].z;
+    packet.bound[n] = 1e9f;
+    if (n == 0) packet.lo = packet.hi = positions[i];
+    packet.lo = Vec3{std::min(packet.lo.x, packet.x[n]), std::min(packet.lo.y, packet.y[n]),
+                     std::min(packet.lo.z, packet.z[n])};
+    packet.hi = Vec3{std::max(packet.hi.x, packet.x[n]), std::max(packet.hi.y, packet.y[n]),
+                     std::max(packet.hi.z, packet.z[n])};
+  }
+  if (packet.count == 0) return count;
+
+  // colliders in slot order, as the broadphase applies them, with one type
+  // switch per collider and packet instead of one per particle
+  for (const ColliderSlot& slot : order) {
+    const ColliderBucket& bucket = buckets[slot.bucket];
+    const SDFCollider& collider = built[bucket.index[slot.entry]];
+    switch (bucket.type) {
+    case RGObjectType::S_CHANNEL:
+      ProjectCollider<RGObjectType::S_CHANNEL>(bucket, slot.entry, collider, packet, positions, velocities);
+      break;
+    case RGObjectType::L_CHANNEL:
+      ProjectCollider<RGObjectType::L_CHANNEL>(bucket, slot.entry, collider, packet, positions, velocities);
+      break;
+    case RGObjectType::RAMP:
+      ProjectCollider<RGObjectType::RAMP>(bucket, slot.entry, collider, packet, positions, velocities);
+      break;
+    case RGObjectType::MESH:
+      ProjectCollider<RGObjectType::MESH>(bucket, slot.entry, collider, packet, positions, velocities);
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (bounds)
+    for (int i = 0; i < packet.count; ++i)
+      bounds[packet.lane[i]].Store(positions[packet.lane[i]], packet.bound[i]);
+  return count - packet.count;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "editor_state.h"
+#include "collider_broadphase.h"
+#include "collision_cache.h"
+
+constexpr int COLLIDER_PACKET = 64;   // particles per packet in the bucketed collision pass
+
+// Colliders of one RGObjectType, one column per field
+struct ColliderBucket {
+  RGObjectType type = RGObjectType::BOX;
+  std::vector<int>   index;                       // slot in the collider array
+  std::vector<float> positionX, positionY, positionZ;
+  std::vector<float> axis[3][3];                  // axis[a][c]: component c of rotationAxes[a]
+  std::vector<float> boundsLoX, boundsLoY, boundsLoZ;
+  std::vector<float> boundsHiX, boundsHiY, boundsHiZ;
+
+  int Size() const { return (int)index.size(); }
+};
+
+// The collider set grouped by type. A packet of consecutive particles (kept
+// spatially close by the Morton reorder) is tested against one collider at
+// a time: when the collider's box overlaps the packet's box, its type's
+// distance runs over the whole packet as a straight loop with no per-pair
+// dispatch, and only the penetrating particles take the scalar push-out.
+// Colliders are visited in slot order, so results match the per-particle
+// broadphase pass bit for bit.
+class ColliderBuckets {
+public:
+  // Re-bounds the slots that differ from the last call (or were added) and
+  // regroups; true if any slot changed
+  bool Update(const SDFCollider* colliders, int count);
+
+  // Projects positions[0, count) out of every collider, count <= COLLIDER_PACKET.
+  // With bounds, particles their bound covers are skipped and the rest get
+  // fresh bounds; returns the number skipped.
+  int ProjectPacket(Vec3* positions, Vec3* velocities, int count,
+                    CollisionBound* bounds = nullptr) const;
+
+  int ColliderCount() const;
+
+private:
+  void Build();
+
+  struct ColliderSlot { int bucket, entry; };
+
+  std::vector<SDFCollider>    built;    // colliders the buckets were built from
+  std::vector<ColliderSlotBounds> slotBounds;  // per slot
+  bool                        updated = false;
+  std::vector<ColliderBucket> buckets;  // non-empty only
+  std::vector<ColliderSlot>   order;    // every bucket entry, by collider slot
+};
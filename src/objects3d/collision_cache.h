@@ -0,0 +1,36 @@
+#pragma once
+#include <algorithm>
+#include "../linear_algebra.h"
+
+// Rounding allowance taken off every stored bound
+constexpr float COLLISION_BOUND_SLACK = 1e-5f;
+
+// Lower bound on the distance from anchor to every SDF collider, kept per
+// particle across solver passes and frames. Each collider's distance drops
+// by at most its slope per unit moved, so a particle still closer to anchor
+// than bound cannot have reached one and skips the collision pass.
+struct CollisionBound {
+  Vec3  anchor{0.0f, 0.0f, 0.0f};
+  float bound = 0.0f;   // 0: evaluate on the next pass
+
+  bool Covers(const Vec3& p) const {
+    Vec3 d = p - anchor;
+    return d.Dot(d) < bound * bound;
+  }
+
+  // False when the box [lo, hi] is at least bound away from anchor, so a
+  // collider placed inside it leaves the bound valid
+  bool Reaches(const Vec3& lo, const Vec3& hi) const {
+    float dx = std::max(std::max(lo.x - anchor.x, anchor.x - hi.x), 0.0f);
+    float dy = std::max(std::max(lo.y - anchor.y, anchor.y - hi.y), 0.0f);
+    float dz = std::max(std::max(lo.z - anchor.z, anchor.z - hi.z), 0.0f);
+    return dx * dx + dy * dy + dz * dz < bound * bound;
+  }
+
+  // distance is the smallest bound over the colliders at p, negative when p
+  // was pushed out of one
+  void Store(const Vec3& p, float distance) {
+    anchor = p;
+    bound  = std::max(distance - COLLISION_BOUND_SLACK, 0.0f);
+  }
+};
@@ -3,7 +3,7 @@
 #include <string>
 #include "grid_state.h"
 
-#define MAX_OBJECTS 125 // 5 x 5 x 5
+#define MAX_OBJECTS 125 // 5 x 5 x 5: benchmark layouts and triangle colliders; editor scenes are unbounded
 
 enum class RGPortKind { Input, Output, Bidirectional };
 
@@ -14,7 +14,8 @@ struct RGPort {
   Vec3        localDir;
 };
 
-enum class RGObjectType { BOX, L_CHANNEL, S_CHANNEL, RAMP };
+enum class RGObjectType { BOX, L_CHANNEL, S_CHANNEL, RAMP, MESH }; // MESH: baked from meshColliderPath
+constexpr int RG_OBJECT_TYPES = 5;
 
 struct SDFCollider {
   RGObjectType type= RGObjectType::BOX;
@@ -23,11 +24,48 @@ struct SDFCollider {
   float restitution;
 };
 
-// Triangle Collision (for Benchmarking)
+struct AppState;
+
+// The editor's colliders, one slot per occupied grid cell. Edits only mark
+// their slot dirty; Flush() sends the dirty slots (and the new slot count)
+// to the simulation and the device in one batch, so a scene load costs one
+// transfer instead of one per object.
+class ColliderRegistry {
+public:
+  // Grows to idx + 1 slots if needed; marks idx dirty unless collider is
+  // already in it
+  void Set(size_t idx, const SDFCollider& collider);
+  void Clear(size_t idx) { Set(idx, SDFCollider{}); }
+  // Drops the slots from count on
+  void Resize(size_t count);
+
+  const SDFCollider& operator[](size_t idx) const { return slots[idx]; }
+  const SDFCollider* Data() const { return slots.data(); }
+  size_t Size() const { return slots.size(); }
+  int  DirtyCount() const { return dirtyCount; }
+
+  // Posts the dirty slots as one simulation command and clears the flags;
+  // call once per frame, before the step
+  void Flush(AppState* as);
+
+private:
+  std::vector<SDFCollider> slots;
+  std::vector<bool>        dirty;
+  int                      dirtyCount = 0;
+  bool                     resized    = false;
+};
+
+class TriangleBVH;
+
+// Triangle Collision (for Benchmarking). Instances share one local-space
+// mesh and place it with a rigid transform, as SDFCollider does.
 struct TriCollider {
   Vec3 *triangles;
   size_t count;
   float restitution;
+  const TriangleBVH *bvh = nullptr; // host-side hierarchy over triangles (CPU path)
+  Vec3 worldPosition;
+  Vec3 rotationAxes[3];
 };
 
 struct RGObject {
@@ -45,9 +83,9 @@ struct RGObject {
 };
 
 struct EditorState {
-  RGObject objects[MAX_OBJECTS];        // rebuilt from committed grid
-  RGObject previewObjects[MAX_OBJECTS]; // ghost render only, no collision
-  SDFCollider colliders[MAX_OBJECTS];
+  std::vector<RGObject> objects;        // one per grid.cells slot
+  RGObject              previewObject;  // ghost render only, no collision
+  ColliderRegistry      colliders;      // one per grid.cells slot
   GridState             grid;
 
   // Preview state
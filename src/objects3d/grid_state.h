@@ -1,13 +1,17 @@
 #pragma once
 #include "../linear_algebra.h"
-#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 constexpr int   GRID_X    = 5;
 constexpr int   GRID_Y    = 5;
 constexpr int   GRID_Z    = 5;
 constexpr float CELL_SIZE = 2.0f / static_cast<float>(GRID_X); // 0.4
+// GRID_X/Y/Z span the fluid domain, where the cursor moves; placed cells
+// are stored sparsely and are not limited to it
 
-enum class Feature     { EMPTY, RAMP, S_CHANNEL, L_CHANNEL };
+enum class Feature     { EMPTY, RAMP, S_CHANNEL, L_CHANNEL, MESH };
 static constexpr int NUM_FEATURES = 8;
 enum class Orientation { North, East, South, West };
 // Yaw mapping: North=0, East=PI/2, South=PI, West=3*PI/2
@@ -18,13 +22,34 @@ struct CellFeature {
     int         variant = 0; // Ramp: 0=highest step in cell, 4=lowest step
 };
 
+// A placed (non-EMPTY) cell
+struct GridCell {
+    int         x, y, z;
+    CellFeature feature;
+};
+
 struct GridState {
-    std::array<CellFeature, GRID_X * GRID_Y * GRID_Z> layout = {};
+    // Occupied cells only, packed, in no particular order; the editor's
+    // objects and colliders use the same slots. cellSlot finds a cell's slot.
+    std::vector<GridCell>             cells;
+    std::unordered_map<uint64_t, int> cellSlot;
+    uint64_t revision = 0;   // bumped by every change to cells
     int selX = 2, selY = 2, selZ = 2;
 
+    // Dense index into the GRID_X * GRID_Y * GRID_Z domain box (benchmark layouts)
     int CellIndex(int x, int y, int z) const {
         return x + y * GRID_X + z * GRID_X * GRID_Y;
     }
+    // 21 bits per axis, offset so negative coordinates pack too
+    static uint64_t CellKey(int x, int y, int z) {
+        constexpr int bias = 1 << 20;
+        return (uint64_t)(x + bias) | (uint64_t)(y + bias) << 21 | (uint64_t)(z + bias) << 42;
+    }
+    // Slot of (x, y, z) in cells, -1 when empty
+    int Slot(int x, int y, int z) const {
+        auto it = cellSlot.find(CellKey(x, y, z));
+        return it == cellSlot.end() ? -1 : it->second;
+    }
     bool IsValidCell(int x, int y, int z) const {
         return x >= 0 && x < GRID_X &&
                y >= 0 && y < GRID_Y &&
@@ -37,10 +62,42 @@ struct GridState {
             -1.0f + (z + 0.5f) * CELL_SIZE
         };
     }
-    CellFeature& GetCell(int x, int y, int z) {
-        return layout[CellIndex(x, y, z)];
-    }
     const CellFeature& GetCell(int x, int y, int z) const {
-        return layout[CellIndex(x, y, z)];
+        static const CellFeature empty;
+        int slot = Slot(x, y, z);
+        return slot < 0 ? empty : cells[slot].feature;
+    }
+
+    // Stores a non-EMPTY feature at (x, y, z); returns its slot, appended
+    // at the end when the cell was empty
+    int SetCell(int x, int y, int z, const CellFeature& feature) {
+        ++revision;
+        auto [it, added] = cellSlot.try_emplace(CellKey(x, y, z), (int)cells.size());
+        if (added)
+            cells.push_back(GridCell{x, y, z, feature});
+        else
+            cells[it->second].feature = feature;
+        return it->second;
+    }
+    // Empties (x, y, z) by moving the last cell into its slot; returns the
+    // freed slot, -1 if the cell was already empty
+    int EraseCell(int x, int y, int z) {
+        auto it = cellSlot.find(CellKey(x, y, z));
+        if (it == cellSlot.end()) return -1;
+        ++revision;
+        const int slot = it->second;
+        cellSlot.erase(it);
+        if (slot != (int)cells.size() - 1) {
+            cells[slot] = cells.back();
+            const GridCell& moved = cells[slot];
+            cellSlot[CellKey(moved.x, moved.y, moved.z)] = slot;
+        }
+        cells.pop_back();
+        return slot;
+    }
+    void Clear() {
+        ++revision;
+        cells.clear();
+        cellSlot.clear();
     }
 };
@@ -0,0 +1,348 @@
+#include "mesh_sdf.h"
+#include "sdf_collision.h"
+#include "triangle_bvh.h"
+#include "../thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "tiny_obj_loader.h"
+
+std::vector<Vec3> LoadOBJTriangles(const std::string &path) {
+  tinyobj::attrib_t attrib;
+  float scale = 0.001f;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string err;
+  std::vector<Vec3> out;
+  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str());
+  if (!err.empty()) std::cerr << "TinyObjLoader: " << err << "\n";
+  if (!ret)
+    return {};
+
+  for (size_t s = 0; s < shapes.size(); s++) {
+    size_t index_offset = 0;
+    for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
+      size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
+
+      for (size_t v = 0; v < fv; v++) {
+	tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+	tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
+	tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
+	tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
+        // Y/Z swap and scale
+        out.push_back(Vec3{vx * scale, vz * scale, vy * scale});
+      }
+      index_offset += fv;
+    }
+  }
+  return  out;
+}
+
+static float TriangleDistanceSquared(const Vec3* triangles, int t, const Vec3& p)
+{
+  Vec3 d = p - ClosestPtPointTriangle(p, triangles[3 * t], triangles[3 * t + 1], triangles[3 * t + 2]);
+  return d.Dot(d);
+}
+
+// Exact nearest triangle for every node within one voxel of a triangle's box
+static void SeedNearSurface(const std::vector<Vec3>& triangles, const SDFVolume& v,
+                            std::vector<int>& nearest, std::vector<float>& distance2)
+{
+  const int numTriangles = (int)(triangles.size() / 3);
+  for (int t = 0; t < numTriangles; ++t) {
+    const Vec3* tri = &triangles[3 * t];
+    Vec3 lo{std::min({tri[0].x, tri[1].x, tri[2].x}), std::min({tri[0].y, tri[1].y, tri[2].y}),
+            std::min({tri[0].z, tri[1].z, tri[2].z})};
+    Vec3 hi{std::max({tri[0].x, tri[1].x, tri[2].x}), std::max({tri[0].y, tri[1].y, tri[2].y}),
+            std::max({tri[0].z, tri[1].z, tri[2].z})};
+    int x0 = std::max(0, (int)std::floor((lo.x - v.origin.x) * v.invVoxel) - 1);
+    int y0 = std::max(0, (int)std::floor((lo.y - v.origin.y) * v.invVoxel) - 1);
+    int z0 = std::max(0, (int)std::floor((lo.z - v.origin.z) * v.invVoxel) - 1);
+    int x1 = std::min(v.nx - 1, (int)std::ceil((hi.x - v.origin.x) * v.invVoxel) + 1);
+    int y1 = std::min(v.ny - 1, (int)std::ceil((hi.y - v.origin.y) * v.invVoxel) + 1);
+    int z1 = std::min(v.nz - 1, (int)std::ceil((hi.z - v.origin.z) * v.invVoxel) + 1);
+    for (int z = z0; z <= z1; ++z)
+      for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x) {
+          size_t idx = x + (size_t)v.nx * (y + (size_t)v.ny * z);
+          Vec3 p = v.origin + Vec3{(float)x, (float)y, (float)z} * v.voxel;
+          float d2 = TriangleDistanceSquared(triangles.data(), t, p);
+          if (d2 < distance2[idx]) {
+            distance2[idx] = d2;
+            nearest[idx]   = t;
+          }
+        }
+  }
+}
+
+// Jump flooding: each pass offers every node the nearest triangles of its 26
+// neighbours step nodes away, halving step down to 1, plus one more pass at
+// step 1 to mend the few nodes the halving sequence gets wrong.
+static void JumpFlood(const std::vector<Vec3>& triangles, const SDFVolume& v,
+                      std::vector<int>& nearest, std::vector<float>& distance2)
+{
+  const int numNodes = v.nx * v.ny * v.nz;
+  std::vector<int>   nextNearest(numNodes);
+  std::vector<float> nextDistance2(numNodes);
+
+  int step = 1;
+  while (step * 2 < std::max({v.nx, v.ny, v.nz}))
+    step *= 2;
+  std::vector<int> steps;
+  for (; step >= 1; step /= 2)
+    steps.push_back(step);
+  steps.push_back(1);
+
+  for (int s : steps) {
+    GlobalThreadPool().ParallelFor(numNodes, 1024, [&](int idx) {
+      const int x = idx % v.nx;
+      const int y = (idx / v.nx) % v.ny;
+      const int z = idx / (v.nx * v.ny);
+      const Vec3 p = v.origin + Vec3{(float)x, (float)y, (float)z} * v.voxel;
+      int   best  = nearest[idx];
+      float bestD = distance2[idx];
+      for (int dz = -s; dz <= s; dz += s)
+        for (int dy = -s; dy <= s; dy += s)
+          for (int dx = -s; dx <= s; dx += s) {
+            int nx = x + dx, ny = y + dy, nz = z + dz;
+            if (nx < 0 || ny < 0 || nz < 0 || nx >= v.nx || ny >= v.ny || nz >= v.nz) continue;
+            int t = nearest[nx + v.nx * (ny + v.ny * nz)];
+            if (t < 0 || t == best) continue;
+            float d2 = TriangleDistanceSquared(triangles.data(), t, p);
+            if (d2 < bestD) {
+              bestD = d2;
+              best  = t;
+            }
+          }
+      nextNearest[idx]   = best;
+      nextDistance2[idx] = bestD;
+    });
+    nearest.swap(nextNearest);
+    distance2.swap(nextDistance2);
+  }
+}
+
+// Point-in-triangle rule for points on an edge: of the two triangles sharing
+// it, only the one traversing it counter-clockwise in this direction counts
+static bool OwnsEdge(float dy, float dz)
+{
+  return dz < 0.0f || (dz == 0.0f && dy > 0.0f);
+}
+
+// Winding number of every node: each triangle adds its orientation to the
+// rows (fixed y, z) it crosses, at the first node past the crossing, and a
+// prefix sum along x turns those into counts
+static void WindingNumbers(const std::vector<Vec3>& triangles, const SDFVolume& v,
+                           std::vector<int>& winding)
+{
+  const int numTriangles = (int)(triangles.size() / 3);
+  for (int t = 0; t < numTriangles; ++t) {
+    Vec3 a = triangles[3 * t], b = triangles[3 * t + 1], c = triangles[3 * t + 2];
+    float area = (b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y);
+    if (area == 0.0f) continue;   // parallel to the rows
+    const int orientation = area > 0.0f ? 1 : -1;
+    if (area < 0.0f) {
+      std::swap(b, c);
+      area = -area;
+    }
+
+    int y0 = std::max(0, (int)std::ceil((std::min({a.y, b.y, c.y}) - v.origin.y) * v.invVoxel));
+    int z0 = std::max(0, (int)std::ceil((std::min({a.z, b.z, c.z}) - v.origin.z) * v.invVoxel));
+    int y1 = std::min(v.ny - 1, (int)std::floor((std::max({a.y, b.y, c.y}) - v.origin.y) * v.invVoxel));
+    int z1 = std::min(v.nz - 1, (int)std::floor((std::max({a.z, b.z, c.z}) - v.origin.z) * v.invVoxel));
+    for (int z = z0; z <= z1; ++z)
+      for (int y = y0; y <= y1; ++y) {
+        float py = v.origin.y + y * v.voxel;
+        float pz = v.origin.z + z * v.voxel;
+        // edge functions, each the doubled area opposite one vertex
+        float ea = (c.y - b.y) * (pz - b.z) - (c.z - b.z) * (py - b.y);
+        float eb = (a.y - c.y) * (pz - c.z) - (a.z - c.z) * (py - c.y);
+        float ec = (b.y - a.y) * (pz - a.z) - (b.z - a.z) * (py - a.y);
+        if (ea < 0.0f || eb < 0.0f || ec < 0.0f) continue;
+        if (ea == 0.0f && !OwnsEdge(c.y - b.y, c.z - b.z)) continue;
+        if (eb == 0.0f && !OwnsEdge(a.y - c.y, a.z - c.z)) continue;
+        if (ec == 0.0f && !OwnsEdge(b.y - a.y, b.z - a.z)) continue;
+
+        float px = (ea * a.x + eb * b.x + ec * c.x) / area;
+        int first = (int)std::floor((px - v.origin.x) * v.invVoxel) + 1;
+        first = std::max(first, 0);
+        if (first < v.nx)
+          winding[first + v.nx * (y + v.ny * z)] += orientation;
+      }
+  }
+
+  GlobalThreadPool().ParallelFor(v.ny * v.nz, 16, [&](int row) {
+    int* w = &winding[(size_t)row * v.nx];
+    for (int x = 1; x < v.nx; ++x)
+      w[x] += w[x - 1];
+  });
+}
+
+// Largest |baked - exact| at voxel centres near the surface, exact distances
+// coming from a BVH query with the sign of the nearest face
+static float MeasureError(const std::vector<Vec3>& triangles, const SDFVolume& v)
+{
+  TriangleBVH bvh;
+  bvh.Build(triangles.data(), triangles.size());
+  const float band = 4.0f * v.voxel;
+  float maxError = 0.0f;
+  for (int z = 0; z + 1 < v.nz; ++z)
+    for (int y = 0; y + 1 < v.ny; ++y)
+      for (int x = 0; x + 1 < v.nx; ++x) {
+        Vec3 p = v.origin + Vec3{x + 0.5f, y + 0.5f, z + 0.5f} * v.voxel;
+        float baked;
+        Vec3  gradient;
+        if (!v.Sample(p, baked, gradient) || std::fabs(baked) > band) continue;
+        TriangleHit hit;
+        if (!bvh.Closest(p, std::numeric_limits<float>::infinity(), hit)) continue;
+        float exact = std::sqrt(hit.distanceSquared);
+        if ((hit.point - p).Dot(hit.normal) > 0.0f) exact = -exact;
+        maxError = std::max(maxError, std::fabs(baked - exact));
+      }
+  return maxError;
+}
+
+bool BakeMeshSDF(const std::vector<Vec3>& triangles, int resolution, SDFVolume& volume)
+{
+  volume = SDFVolume{};
+  if (triangles.size() < 3) return false;
+
+  Vec3 lo = triangles[0], hi = triangles[0];
+  for (const Vec3& p : triangles) {
+    lo = Vec3{std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z)};
+    hi = Vec3{std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z)};
+  }
+  Vec3 size = hi - lo;
+  float longest = std::max(size.x, std::max(size.y, size.z));
+  resolution = std::max(resolution, 4);
+
+  // same margin as the analytic volumes: the trilinear stencil stays inside
+  volume.voxel    = longest / (float)(resolution - 1);
+  volume.invVoxel = 1.0f / volume.voxel;
+  const float margin = 2.0f * volume.voxel;
+  volume.origin = lo - Vec3{margin, margin, margin};
+  volume.nx = (int)std::ceil((size.x + 2.0f * margin) * volume.invVoxel) + 1;
+  volume.ny = (int)std::ceil((size.y + 2.0f * margin) * volume.invVoxel) + 1;
+  volume.nz = (int)std::ceil((size.z + 2.0f * margin) * volume.invVoxel) + 1;
+  const size_t numNodes = (size_t)volume.nx * volume.ny * volume.nz;
+
+  std::vector<int>   nearest(numNodes, -1);
+  std::vector<float> distance2(numNodes, std::numeric_limits<float>::infinity());
+  SeedNearSurface(triangles, volume, nearest, distance2);
+  JumpFlood(triangles, volume, nearest, distance2);
+
+  std::vector<int> winding(numNodes, 0);
+  WindingNumbers(triangles, volume, winding);
+
+  volume.distances.resize(numNodes);
+  for (size_t i = 0; i < numNodes; ++i) {
+    float d = std::sqrt(distance2[i]);
+    volume.distances[i] = winding[i] != 0 ? -d : d;
+  }
+  volume.MeasureSlope();
+  volume.maxError = MeasureError(triangles, volume);
+  return true;
+}
+
+static uint64_t HashMesh(const std::vector<Vec3>& triangles, int resolution)
+{
+  uint64_t hash = 1469598103934665603ull;   // FNV-1a
+  auto mix = [&](const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; ++i)
+      hash = (hash ^ p[i]) * 1099511628211ull;
+  };
+  mix(triangles.data(), triangles.size() * sizeof(Vec3));
+  mix(&resolution, sizeof(resolution));
+  mix(&MESH_SDF_CACHE_VERSION, sizeof(MESH_SDF_CACHE_VERSION));
+  return hash;
+}
+
+struct MeshSDFHeader {
+  char     magic[4];
+  uint32_t version;
+  uint64_t hash;
+  int32_t  nx, ny, nz;
+  float    origin[3];
+  float    voxel;
+  float    maxError;
+};
+
+static bool ReadCache(const std::filesystem::path& path, uint64_t hash, SDFVolume& volume)
+{
+  std::ifstream in(path, std::ios::binary);
+  MeshSDFHeader header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+  if (std::memcmp(header.magic, "MSDF", 4) != 0 || header.version != MESH_SDF_CACHE_VERSION ||
+      header.hash != hash || header.nx < 2 || header.ny < 2 || header.nz < 2)
+    return false;
+
+  volume = SDFVolume{};
+  volume.origin   = Vec3{header.origin[0], header.origin[1], header.origin[2]};
+  volume.voxel    = header.voxel;
+  volume.invVoxel = 1.0f / header.voxel;
+  volume.nx = header.nx;
+  volume.ny = header.ny;
+  volume.nz = header.nz;
+  volume.maxError = header.maxError;
+  volume.distances.resize((size_t)header.nx * header.ny * header.nz);
+  if (!in.read(reinterpret_cast<char*>(volume.distances.data()),
+               volume.distances.size() * sizeof(float))) {
+    volume = SDFVolume{};
+    return false;
+  }
+  volume.MeasureSlope();
+  return true;
+}
+
+static void WriteCache(const std::filesystem::path& path, uint64_t hash, const SDFVolume& volume)
+{
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  MeshSDFHeader header{{'M', 'S', 'D', 'F'}, MESH_SDF_CACHE_VERSION, hash,
+                       volume.nx, volume.ny, volume.nz,
+                       {volume.origin.x, volume.origin.y, volume.origin.z},
+                       volume.voxel, volume.maxError};
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(volume.distances.data()),
+            volume.distances.size() * sizeof(float));
+  if (!out)
+    std::cerr << "Mesh SDF: could not write " << path.string() << "\n";
+}
+
+bool LoadMeshSDF(const std::string& objPath, int resolution, SDFVolume& volume)
+{
+  std::vector<Vec3> triangles = LoadOBJTriangles(objPath);
+  if (triangles.size() < 3) {
+    volume = SDFVolume{};
+    return false;
+  }
+
+  const uint64_t hash = HashMesh(triangles, resolution);
+  char key[17];
+  std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+  std::filesystem::path cachePath = std::filesystem::path(MESH_SDF_CACHE_DIR) /
+    (std::filesystem::path(objPath).stem().string() + "-" + key + ".sdf");
+
+  const char* source = "cached";
+  auto start = std::chrono::steady_clock::now();
+  if (!ReadCache(cachePath, hash, volume)) {
+    BakeMeshSDF(triangles, resolution, volume);
+    WriteCache(cachePath, hash, volume);
+    source = "baked";
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Mesh SDF " << objPath << ": " << volume.nx << "x" << volume.ny << "x" << volume.nz
+            << ", max error " << volume.maxError << " (" << source << " in " << ms << " ms)"
+            << std::endl;
+  return true;
+}
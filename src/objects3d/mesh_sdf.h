@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "sdf_volume.h"
+
+constexpr const char* MESH_SDF_CACHE_DIR     = "meshes/cache";
+constexpr uint32_t    MESH_SDF_CACHE_VERSION = 1;  // bump when the baked values change
+
+// Triangles of an OBJ file, three vertices each, scaled and Y/Z swapped the
+// same way the object renderer draws the meshes
+std::vector<Vec3> LoadOBJTriangles(const std::string &path);
+
+// Signed distance grid over a closed triangle mesh with resolution nodes
+// along its longest axis, laid out like the analytic volumes. Nodes within
+// one voxel of a triangle get exact distances; jump flooding carries the
+// nearest triangle to the rest of the grid. The sign is the winding number
+// from signed ray crossings along x, so the mesh must be closed but may use
+// either winding. Runs on the global thread pool.
+bool BakeMeshSDF(const std::vector<Vec3>& triangles, int resolution, SDFVolume& volume);
+
+// Volume for the OBJ at objPath from MESH_SDF_CACHE_DIR, baked and stored
+// there on a miss. Cache files are keyed by a hash of the triangles, the
+// resolution and MESH_SDF_CACHE_VERSION. False when the OBJ has no triangles.
+bool LoadMeshSDF(const std::string& objPath, int resolution, SDFVolume& volume);
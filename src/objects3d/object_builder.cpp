@@ -19,9 +19,7 @@ float orientationYaw(Orientation o)
   return 0.0f;
 }
 
-static void addCellObject(RGObject* objects,
-                              const CellFeature& cf,
-			  Vec3 c, float yaw, size_t idx)
+static RGObject cellObject(const CellFeature& cf, Vec3 c, float yaw)
 {
   RGObjectType type;
   switch (cf.feature) {
@@ -30,8 +28,9 @@ static void addCellObject(RGObject* objects,
     type = RGObjectType::S_CHANNEL;
     break;
   case Feature::RAMP: type = RGObjectType::RAMP; break;
-  case Feature::EMPTY:     return;
-  default:                 return; // unimplemented features ignored for now
+  case Feature::MESH: type = RGObjectType::MESH; break;
+  case Feature::EMPTY:     return RGObject{};
+  default:                 return RGObject{}; // unimplemented features ignored for now
   }
 
   RGObject obj;
@@ -40,20 +39,43 @@ static void addCellObject(RGObject* objects,
   obj.position = c;
   obj.rotation = {0.0f, yaw, 0.0f};
   obj.halfExtents = {CELL_SIZE * 0.5f, CELL_SIZE * 0.5f, CELL_SIZE * 0.5f};
-  objects[idx] = obj;
+  return obj;
 }
 
-void regenerateObjectFromGrid(const GridState& grid, EditorState& state)
+static RGObject cellObject(const GridState& grid, const GridCell& cell)
+{
+  return cellObject(cell.feature, grid.CellCenterWorld(cell.x, cell.y, cell.z),
+                    orientationYaw(cell.feature.facing));
+}
+
+// Writes feature to (x, y, z) with its object and collider, which share the
+// cell's slot; EMPTY removes the cell
+static void placeCell(EditorState& state, int x, int y, int z, const CellFeature& feature)
 {
-  const CellFeature &cf = grid.GetCell(grid.selX, grid.selY, grid.selZ);
-  size_t cellIdx = grid.CellIndex(grid.selX, grid.selY, grid.selZ);
-  if (cf.feature == Feature::EMPTY) {
-    state.objects[cellIdx] = RGObject{};
+  GridState& grid = state.grid;
+  if (feature.feature == Feature::EMPTY) {
+    // the last cell moves into the freed slot, and its object and collider with it
+    const int last = (int)grid.cells.size() - 1;
+    const int slot = grid.EraseCell(x, y, z);
+    if (slot < 0) return;
+    state.objects[slot] = state.objects[last];
+    state.objects.pop_back();
+    state.colliders.Set(slot, state.colliders[last]);
+    state.colliders.Resize(last);
     return;
   }
-  Vec3  c   = grid.CellCenterWorld(grid.selX, grid.selY, grid.selZ);
-  float yaw = orientationYaw(cf.facing);
-  addCellObject(state.objects, cf, c, yaw, cellIdx);
+  const int slot = grid.SetCell(x, y, z, feature);
+  if (slot >= (int)state.objects.size())
+    state.objects.resize(slot + 1);
+  state.objects[slot] = cellObject(grid, grid.cells[slot]);
+  addCollider(state.colliders, state.objects, slot);
+}
+
+void regenerateObjectFromGrid(const GridState& grid, EditorState& state)
+{
+  const int slot = grid.Slot(grid.selX, grid.selY, grid.selZ);
+  if (slot < 0) return;
+  state.objects[slot] = cellObject(grid, grid.cells[slot]);
 }
 
 void startPreview(GridState& grid, EditorState& state)
@@ -66,67 +88,59 @@ void startPreview(GridState& grid, EditorState& state)
   // Exclude the preview cell from solid collision objects
   regenerateObjectFromGrid(grid, state);
   // Build initial ghost from current cell content (may be empty)
-  addPreviewObject(state, grid.CellIndex(grid.selX, grid.selY, grid.selZ));
+  addPreviewObject(state);
 }
 
-void addPreviewObject(EditorState& state, size_t cellIdx)
+void addPreviewObject(EditorState& state)
 {
-  state.previewObjects[cellIdx] = RGObject{};
-  state.objects[cellIdx] = RGObject{};
+  state.previewObject = RGObject{};
+  const int slot = state.grid.Slot(state.previewX, state.previewY, state.previewZ);
+  if (slot >= 0)
+    state.objects[slot] = RGObject{};
   if (!state.previewActive) return;
   Vec3  c   = state.grid.CellCenterWorld(state.previewX, state.previewY, state.previewZ);
   float yaw = orientationYaw(state.previewCell.facing);
-  addCellObject(state.previewObjects, state.previewCell, c, yaw, cellIdx);
+  state.previewObject = cellObject(state.previewCell, c, yaw);
 }
 
 
-void commitPreview(GridState& grid, EditorState& state, AppState* as)
+void commitPreview(EditorState& state)
 {
-  grid.GetCell(state.previewX, state.previewY, state.previewZ) =
-      state.previewCell;
-  size_t cellIdx = grid.CellIndex(state.previewX, state.previewY, state.previewZ); 
   state.previewActive = false;
-  state.previewObjects[cellIdx] = RGObject{};
-  regenerateObjectFromGrid(grid,state); 
-  addCollider(state.colliders, state.objects, cellIdx, as);
+  state.previewObject = RGObject{};
+  placeCell(state, state.previewX, state.previewY, state.previewZ, state.previewCell);
 }
 
 void cancelPreview(GridState& grid, EditorState& state)
 {
   state.previewActive = false;
-  state.previewObjects[grid.CellIndex(state.previewX, state.previewY, state.previewZ)] = RGObject{};
+  state.previewObject = RGObject{};
   regenerateObjectFromGrid(grid, state); // restore old cell's geometry
 }
 
-void clearScene(EditorState& state, AppState* as)
+void clearScene(EditorState& state)
 {
-  for (size_t j{}; j < MAX_OBJECTS; ++j) {
-    state.objects[j] = RGObject{};
-    deleteCollider(state.colliders, j, as);
-  }
+  state.grid.Clear();
+  state.objects.clear();
+  state.colliders.Resize(0);
 }
 
-void buildFromList(std::vector<ScenePlacement> &placeList, GridState& grid, EditorState &state, AppState* as) {
-  for (const auto &e : placeList) {
-    const CellFeature &cf = e.feature;
-    size_t cellIdx = grid.CellIndex(e.x, e.y, e.z);
-    if (cf.feature == Feature::EMPTY) continue;
-    Vec3  c   = grid.CellCenterWorld(e.x, e.y, e.z);
-    float yaw = orientationYaw(cf.facing);
-    addCellObject(state.objects, cf, c, yaw, cellIdx);
-    addCollider(state.colliders, state.objects, cellIdx, as);
-  }
+void buildFromList(std::vector<ScenePlacement> &placeList, EditorState &state) {
+  state.grid.cells.reserve(state.grid.cells.size() + placeList.size());
+  for (const auto &e : placeList)
+    placeCell(state, e.x, e.y, e.z, e.feature);
 }
 
-void loadDefaultScene(EditorState& state, AppState* as)
+TricklerSettings loadDefaultScene(EditorState& state)
 {
-  clearScene(state, as);
+  clearScene(state);
 
-  tricklerMode      = true;
-  tricklerOriginX   = -0.8f;
-  tricklerOriginY   =  1.0f;
-  tricklerOriginZ   =  -0.8f;
-  tricklerSpawnRate = 300.0f;
+  TricklerSettings trickler;
+  trickler.mode      = true;
+  trickler.originX   = -0.8f;
+  trickler.originY   =  1.0f;
+  trickler.originZ   =  -0.8f;
+  trickler.spawnRate = 300.0f;
 
   std::vector<ScenePlacement> placeList;
 
@@ -154,7 +168,8 @@ void loadDefaultScene(EditorState& state, AppState* as)
   placeList.push_back({4, 1, 1, {Feature::RAMP, Orientation::North, 0}});
   placeList.push_back({4, 1, 0, {Feature::L_CHANNEL, Orientation::North, 0}});
 
-  buildFromList(placeList, state.grid,state, as);
+  buildFromList(placeList, state);
+  return trickler;
 }
 
 // ---------------------------------------------------------------------------
@@ -170,29 +185,27 @@ void navigateCell(GridState& grid, int dx, int dy, int dz)
 
 void cycleCellFeature(GridState& grid, EditorState& state, int delta)
 {
-  CellFeature& cf = grid.GetCell(grid.selX, grid.selY, grid.selZ);
+  CellFeature cf = grid.GetCell(grid.selX, grid.selY, grid.selZ);
   int n = (((int)cf.feature + delta) % NUM_FEATURES + NUM_FEATURES) % NUM_FEATURES;
   cf.feature = static_cast<Feature>(n);
-  regenerateObjectFromGrid(grid, state);
+  placeCell(state, grid.selX, grid.selY, grid.selZ, cf);
 }
 
 void rotateCellOrientation(GridState& grid, EditorState& state, int delta)
 {
-  CellFeature& cf = grid.GetCell(grid.selX, grid.selY, grid.selZ);
+  CellFeature cf = grid.GetCell(grid.selX, grid.selY, grid.selZ);
   int n = (static_cast<int>(cf.facing) + delta + 4) % 4;
   cf.facing = static_cast<Orientation>(n);
-  regenerateObjectFromGrid(grid, state);
+  placeCell(state, grid.selX, grid.selY, grid.selZ, cf);
 }
 
 void cycleCellVariant(GridState& grid, EditorState& state, int delta)
 {
-  CellFeature& cf = grid.GetCell(grid.selX, grid.selY, grid.selZ);
+  CellFeature cf = grid.GetCell(grid.selX, grid.selY, grid.selZ);
   cf.variant = std::max(0, std::min(4, cf.variant + delta));
-  regenerateObjectFromGrid(grid, state);
+  placeCell(state, grid.selX, grid.selY, grid.selZ, cf);
 }
 
-void clearCell(GridState &grid, EditorState &state, AppState* as) {
-  size_t cellIdx = grid.CellIndex(grid.selX, grid.selY, grid.selZ);
-  state.objects[cellIdx] = RGObject{};
-  deleteCollider(state.colliders, cellIdx, as);
+void clearCell(GridState &grid, EditorState &state) {
+  placeCell(state, grid.selX, grid.selY, grid.selZ, CellFeature{});
 }
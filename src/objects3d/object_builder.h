@@ -8,13 +8,21 @@ void regenerateObjectFromGrid(const GridState& grid, EditorState& state);
 
 // Preview workflow
 void startPreview(GridState& grid, EditorState& state);   // snapshot current cell, exclude from solid objects
-void addPreviewObject(EditorState& state, size_t cellIdx);         // rebuild previewObjects from previewCell
-void commitPreview(GridState& grid, EditorState& state, AppState* as);   // write previewCell to grid, rebuild objects
+void addPreviewObject(EditorState& state);         // rebuild previewObject from previewCell
+void commitPreview(EditorState& state);   // write previewCell to grid, rebuild objects
 void cancelPreview(GridState& grid, EditorState& state);   // discard preview, rebuild objects
 
+// Trickler a scene wants; solver parameters, so the caller posts them to
+// the simulation rather than the editor writing the globals
+struct TricklerSettings {
+  bool  mode = false;
+  float originX = 0.0f, originY = 0.0f, originZ = 0.0f;
+  float spawnRate = 0.0f;
+};
+
 // Scene management
-void loadDefaultScene(EditorState& state, AppState* as);
-void clearScene(EditorState& state, AppState* as);
+TricklerSettings loadDefaultScene(EditorState& state);
+void clearScene(EditorState& state);
 
 // Cell navigation (no rebuild)
 void navigateCell(GridState& grid, int dx, int dy, int dz);
@@ -23,6 +31,6 @@ void navigateCell(GridState& grid, int dx, int dy, int dz);
 void cycleCellFeature(GridState& grid, EditorState& state, int delta);
 void rotateCellOrientation(GridState& grid, EditorState& state, int delta);
 void cycleCellVariant(GridState& grid, EditorState& state, int delta);
-void clearCell(GridState& grid, EditorState& state, AppState* as);
+void clearCell(GridState& grid, EditorState& state);
 
 
@@ -1,6 +1,8 @@
 #include "object_renderer.h"
 #include <glad/glad.h>
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -18,6 +20,7 @@ static std::string MeshKeyForType(RGObjectType type) {
   case RGObjectType::L_CHANNEL:
     return "l_channel";
   case RGObjectType::RAMP:   return "ramp";
+  case RGObjectType::MESH:   return "mesh";
   default: return "";
   }
 }
@@ -46,7 +49,7 @@ static unsigned int CompileShaderModule(const char* src, unsigned int type)
   return id;
 }
 
-static unsigned int LinkSolidShader()
+static unsigned int LinkProgram(const char* vertexPath, const char* fragmentPath)
 {
   // Read shader files the same way main.cpp does
   auto readFile = [](const char* path) -> std::string {
@@ -60,46 +63,8 @@ static unsigned int LinkSolidShader()
     return ss.str();
   };
 
-  std::string vs = readFile("src/shaders/solid_vertex.glsl");
-  std::string fs = readFile("src/shaders/solid_fragment.glsl");
-
-  unsigned int v = CompileShaderModule(vs.c_str(), GL_VERTEX_SHADER);
-  unsigned int f = CompileShaderModule(fs.c_str(), GL_FRAGMENT_SHADER);
-
-  unsigned int prog = glCreateProgram();
-  glAttachShader(prog, v);
-  glAttachShader(prog, f);
-  glLinkProgram(prog);
-
-  int ok;
-  glGetProgramiv(prog, GL_LINK_STATUS, &ok);
-  if (!ok) {
-    char log[512];
-    glGetProgramInfoLog(prog, 512, nullptr, log);
-    std::cerr << "ObjectRenderer link error: " << log << "\n";
-  }
-
-  glDeleteShader(v);
-  glDeleteShader(f);
-  return prog;
-}
-
-static unsigned int LinkOverlayShader()
-{
-  // Read shader files the same way main.cpp does
-  auto readFile = [](const char* path) -> std::string {
-    std::ifstream f(path);
-    if (!f.is_open()) {
-      std::cerr << "Cannot open: " << path << "\n";
-      return "";
-    }
-    std::stringstream ss;
-    ss << f.rdbuf();
-    return ss.str();
-  };
-
-  std::string vs = readFile("src/shaders/overlay_vertex.glsl");
-  std::string fs = readFile("src/shaders/overlay_fragment.glsl");
+  std::string vs = readFile(vertexPath);
+  std::string fs = readFile(fragmentPath);
 
   unsigned int v = CompileShaderModule(vs.c_str(), GL_VERTEX_SHADER);
   unsigned int f = CompileShaderModule(fs.c_str(), GL_FRAGMENT_SHADER);
@@ -128,9 +93,18 @@ static unsigned int LinkOverlayShader()
 
 void SetupObjectRenderer(ObjectRenderer& r)
 {
-  r.shader = LinkSolidShader();
-  r.overlayShader = LinkOverlayShader();
-  printf("overlayShader=%u\n", r.overlayShader);
+  r.shader          = LinkProgram("src/shaders/solid_vertex.glsl", "src/shaders/solid_fragment.glsl");
+  r.instancedShader = LinkProgram("src/shaders/solid_instanced_vertex.glsl",
+                                  "src/shaders/solid_fragment.glsl");
+  r.overlayShader   = LinkProgram("src/shaders/overlay_vertex.glsl", "src/shaders/overlay_fragment.glsl");
+
+  r.instancedView       = glGetUniformLocation(r.instancedShader, "uView");
+  r.instancedProjection = glGetUniformLocation(r.instancedShader, "uProjection");
+  r.instancedCameraPos  = glGetUniformLocation(r.instancedShader, "uCameraPos");
+  r.overlayView         = glGetUniformLocation(r.overlayShader, "uView");
+  r.overlayProjection   = glGetUniformLocation(r.overlayShader, "uProjection");
+  r.overlayModel        = glGetUniformLocation(r.overlayShader, "uModel");
+  glGenBuffers(1, &r.instanceVBO);
 
   glGenVertexArrays(1, &r.VAO);
   glGenBuffers(1, &r.VBO);
@@ -141,6 +115,7 @@ void SetupObjectRenderer(ObjectRenderer& r)
   LoadOBJ("meshes/LChannel.obj", r.loadedMeshes["l_channel"]);
   LoadOBJ("meshes/SChannel.obj", r.loadedMeshes["s_channel"]);
   LoadOBJ("meshes/Ramp.obj", r.loadedMeshes["ramp"]);
+  LoadOBJ(meshColliderPath, r.loadedMeshes["mesh"]);
 
   // Vertex layout: pos(3) + normal(3) + colorAlpha(4) = 10 floats = 40 bytes
   constexpr int stride = 10 * sizeof(float);
@@ -158,8 +133,12 @@ void DestroyObjectRenderer(ObjectRenderer& r)
 {
   if (r.VBO) glDeleteBuffers(1, &r.VBO);
   if (r.VAO) glDeleteVertexArrays(1, &r.VAO);
+  if (r.instanceVBO) glDeleteBuffers(1, &r.instanceVBO);
   if (r.shader) glDeleteProgram(r.shader);
-  r.VBO = r.VAO = r.shader = 0;
+  if (r.instancedShader) glDeleteProgram(r.instancedShader);
+  if (r.overlayShader) glDeleteProgram(r.overlayShader);
+  r.VBO = r.VAO = r.instanceVBO = r.shader = r.instancedShader = r.overlayShader = 0;
+  r.instanceCapacity = 0;
 }
 
 // ---------------------------------------------------------------------------
@@ -253,34 +232,122 @@ static Vec3 ObjectColor(RGObjectType type, bool selected)
 
 
 // ---------------------------------------------------------------------------
-// Upload and draw
+// Cached instance and overlay buffers
 // ---------------------------------------------------------------------------
 
-static void FlushBuffer(ObjectRenderer& r, Vec3 color, float alpha)
+static bool SameVec3(const Vec3& a, const Vec3& b)
 {
-  unsigned int tempVAO, tempVBO;
-  glGenVertexArrays(1, &tempVAO);
-  glGenBuffers(1, &tempVBO);
-  glBindVertexArray(tempVAO);
-  glBindBuffer(GL_ARRAY_BUFFER, tempVBO);
-  glBufferData(GL_ARRAY_BUFFER, r.buffer.size() * sizeof(float), r.buffer.data(), GL_DYNAMIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 40, (void*)0);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 40, (void*)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
-  Mat4 identity = Mat4::Identity();
-  glUniformMatrix4fv(glGetUniformLocation(r.shader, "uModel"), 1, GL_FALSE, identity.entries);
-  glUniform4f(glGetUniformLocation(r.shader, "uColor"), color.x, color.y, color.z, alpha);
-  glDrawArrays(GL_TRIANGLES, 0, r.buffer.size() / 10);
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// Everything the instanced pass draws from an object
+static bool SameInstance(const RGObject& a, const RGObject& b)
+{
+  return a.type == b.type && a.active == b.active && SameVec3(a.position, b.position) &&
+         SameVec3(a.rotation, b.rotation) && SameVec3(a.colorOverride, b.colorOverride);
+}
+
+static void UpdateObjectInstances(ObjectRenderer& r, const std::vector<RGObject>& objects)
+{
+  bool changed = objects.size() != r.builtObjects.size();
+  for (size_t i = 0; !changed && i < objects.size(); ++i)
+    changed = !SameInstance(objects[i], r.builtObjects[i]);
+  if (!changed) return;
+  r.builtObjects = objects;
+
+  r.instances.clear();
+  for (auto& [key, mesh] : r.loadedMeshes) {
+    mesh.instanceFirst = (int)r.instances.size();
+    for (const RGObject& object : objects) {
+      if (!object.active || MeshKeyForType(object.type) != key) continue;
+      Vec3 col = (object.colorOverride.x >= 0.0f)
+        ? object.colorOverride
+        : ObjectColor(object.type, false);
+      Mat4 model = Mat4Multiply(CreateMatrixTransform(object.position),
+                                CreateMatrixRotationXYZ(object.rotation));
+      ObjectInstance instance;
+      std::copy(model.entries, model.entries + 16, instance.model);
+      instance.color[0] = col.x;
+      instance.color[1] = col.y;
+      instance.color[2] = col.z;
+      instance.color[3] = 0.6f;
+      r.instances.push_back(instance);
+    }
+    mesh.instanceCount = (int)r.instances.size() - mesh.instanceFirst;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, r.instanceVBO);
+  const size_t bytes = r.instances.size() * sizeof(ObjectInstance);
+  if (r.instances.size() > r.instanceCapacity) {
+    r.instanceCapacity = std::max(r.instances.size(), r.instanceCapacity * 2);
+    glBufferData(GL_ARRAY_BUFFER, r.instanceCapacity * sizeof(ObjectInstance), nullptr,
+                 GL_DYNAMIC_DRAW);
+  }
+  if (bytes > 0)
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, r.instances.data());
+
+  // each mesh's VAO reads its own run of the buffer
+  for (auto& [key, mesh] : r.loadedMeshes) {
+    if (mesh.instanceCount == 0 || !mesh.VAO) continue;
+    glBindVertexArray(mesh.VAO);
+    const size_t base = mesh.instanceFirst * sizeof(ObjectInstance);
+    for (int c = 0; c < 4; ++c) {
+      glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectInstance),
+                            (void*)(base + c * 4 * sizeof(float)));
+      glEnableVertexAttribArray(3 + c);
+      glVertexAttribDivisor(3 + c, 1);
+    }
+    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(ObjectInstance),
+                          (void*)(base + offsetof(ObjectInstance, color)));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+  }
   glBindVertexArray(0);
-  glDeleteVertexArrays(1, &tempVAO);
-  glDeleteBuffers(1, &tempVBO);
+}
+
+static void UpdateOverlay(ObjectRenderer& r, const GridState& grid,
+                          bool showSelectedCell, bool showOccupiedOutlines)
+{
+  if (r.overlayBuilt && r.overlayRevision == grid.revision &&
+      r.overlaySel[0] == grid.selX && r.overlaySel[1] == grid.selY && r.overlaySel[2] == grid.selZ &&
+      r.overlaySelected == showSelectedCell && r.overlayOutlines == showOccupiedOutlines)
+    return;
+  r.overlayBuilt    = true;
+  r.overlayRevision = grid.revision;
+  r.overlaySel[0]   = grid.selX;
+  r.overlaySel[1]   = grid.selY;
+  r.overlaySel[2]   = grid.selZ;
+  r.overlaySelected = showSelectedCell;
+  r.overlayOutlines = showOccupiedOutlines;
+
+  const Vec3 identAxes[3] = {{1,0,0},{0,1,0},{0,0,1}};
   r.buffer.clear();
+  if (showOccupiedOutlines) {
+    constexpr float h = CELL_SIZE * 0.5f - 0.002f;
+    for (const GridCell& cell : grid.cells) {
+      Vec3 c = grid.CellCenterWorld(cell.x, cell.y, cell.z);
+      AppendBox(r.buffer, c, {h, h, h}, identAxes, {0.8f, 0.8f, 0.8f}, 0.30f);
+    }
+  }
+  r.outlineVertices = (int)r.buffer.size() / 10;
+  if (showSelectedCell) {
+    constexpr float h = CELL_SIZE * 0.5f - 0.001f;
+    Vec3 sel = grid.CellCenterWorld(grid.selX, grid.selY, grid.selZ);
+    AppendBox(r.buffer, sel, {h, h, h}, identAxes, {1.0f, 0.9f, 0.1f}, 0.25f);
+  }
+  r.selectedVertices = (int)r.buffer.size() / 10 - r.outlineVertices;
+
+  glBindBuffer(GL_ARRAY_BUFFER, r.VBO);
+  glBufferData(GL_ARRAY_BUFFER, r.buffer.size() * sizeof(float), r.buffer.data(), GL_DYNAMIC_DRAW);
 }
 
+// ---------------------------------------------------------------------------
+// Draw
+// ---------------------------------------------------------------------------
+
 void RenderObjects(ObjectRenderer& r,
-                   RGObject* objects,
-                   RGObject* previewObjs,
+                   const std::vector<RGObject>& objects,
+                   const RGObject* previewObj,
                    const GridState* grid,
                    bool showSelectedCell,
                    bool showOccupiedOutlines,
@@ -296,82 +363,54 @@ void RenderObjects(ObjectRenderer& r,
   GLboolean depthMaskSaved;
   glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMaskSaved);
 
-  glUseProgram(r.shader);
-  glUniformMatrix4fv(glGetUniformLocation(r.shader, "uView"),       1, GL_FALSE, view.entries);
-  glUniformMatrix4fv(glGetUniformLocation(r.shader, "uProjection"), 1, GL_FALSE, projection.entries);
-
-  // --- Pass 1: opaque active objects ---
+  // --- Pass 1: active objects, one instanced draw per mesh ---
+  UpdateObjectInstances(r, objects);
   glDepthMask(GL_TRUE);
-  for (int j{}; j < MAX_OBJECTS; ++j) {
-    if (!objects[j].active) continue;
-    Vec3 col = (objects[j].colorOverride.x >= 0.0f)
-      ? objects[j].colorOverride
-      : ObjectColor(objects[j].type, false);
-    
-    // check if we have a loaded mesh for this type
-    std::string meshKey = MeshKeyForType(objects[j].type);
-    if (!meshKey.empty() && r.loadedMeshes.count(meshKey)) {
-      Mat4 rot = CreateMatrixRotationXYZ(objects[j].rotation);
-      Mat4 trans = CreateMatrixTransform(objects[j].position);
-      Mat4 model = Mat4Multiply(trans, rot);
-      glUniform4f(glGetUniformLocation(r.shader, "uColor"), col.x, col.y, col.z, 0.6f);
-      DrawMesh(r.loadedMeshes[meshKey], model, view, projection, r.shader,
-               cameraPos);
-    }
+  glUseProgram(r.instancedShader);
+  glUniformMatrix4fv(r.instancedView,       1, GL_FALSE, view.entries);
+  glUniformMatrix4fv(r.instancedProjection, 1, GL_FALSE, projection.entries);
+  glUniform3f(r.instancedCameraPos, cameraPos.x, cameraPos.y, cameraPos.z);
+  for (const auto& [key, mesh] : r.loadedMeshes) {
+    if (mesh.instanceCount == 0 || !mesh.VAO) continue;
+    glBindVertexArray(mesh.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0, mesh.instanceCount);
   }
+  glBindVertexArray(0);
 
-
-  if (previewObjs) {
-    for (int j{}; j < MAX_OBJECTS; ++j) {
-      if (!previewObjs[j].active) continue;
-      Vec3 col = ObjectColor(previewObjs[j].type, false);
-      std::string meshKey = MeshKeyForType(previewObjs[j].type);
-      if (!meshKey.empty() && r.loadedMeshes.count(meshKey)) {
-	Mat4 rot = CreateMatrixRotationXYZ(previewObjs[j].rotation);
-	Mat4 trans = CreateMatrixTransform(previewObjs[j].position);
-	Mat4 model = Mat4Multiply(trans, rot);
-	glUniform4f(glGetUniformLocation(r.shader, "uColor"), col.x, col.y, col.z, 0.3f);
-	DrawMesh(r.loadedMeshes[meshKey], model, view, projection, r.shader, cameraPos);
-      }
+  // --- Pass 2: ghost preview ---
+  if (previewObj && previewObj->active) {
+    Vec3 col = ObjectColor(previewObj->type, false);
+    std::string meshKey = MeshKeyForType(previewObj->type);
+    if (!meshKey.empty() && r.loadedMeshes.count(meshKey)) {
+      Mat4 rot = CreateMatrixRotationXYZ(previewObj->rotation);
+      Mat4 trans = CreateMatrixTransform(previewObj->position);
+      Mat4 model = Mat4Multiply(trans, rot);
+      glUseProgram(r.shader);
+      glUniform4f(glGetUniformLocation(r.shader, "uColor"), col.x, col.y, col.z, 0.3f);
+      DrawMesh(r.loadedMeshes[meshKey], model, view, projection, r.shader, cameraPos);
     }
   }
 
-  if (showOccupiedOutlines && grid) {
-    Vec3 identAxes[3] = {{1,0,0},{0,1,0},{0,0,1}};
-    constexpr float h = CELL_SIZE * 0.5f - 0.002f;
-    glDepthMask(GL_FALSE);
-    for (int z = 0; z < GRID_Z; ++z)
-      for (int y = 0; y < GRID_Y; ++y)
-        for (int x = 0; x < GRID_X; ++x) {
-          if (grid->GetCell(x, y, z).feature == Feature::EMPTY) continue;
-          Vec3 c = grid->CellCenterWorld(x, y, z);
-          AppendBox(r.buffer, c, {h, h, h}, identAxes, {0.8f, 0.8f, 0.8f}, 0.30f);
-        }
+  // --- Passes 3 and 4: occupied outlines, selected-cell highlight ---
+  if (grid && (showOccupiedOutlines || showSelectedCell)) {
+    UpdateOverlay(r, *grid, showSelectedCell, showOccupiedOutlines);
     Mat4 identity = Mat4::Identity();
-    glUniformMatrix4fv(glGetUniformLocation(r.shader, "uModel"), 1, GL_FALSE, identity.entries);
+    glUseProgram(r.overlayShader);
+    glUniformMatrix4fv(r.overlayView,       1, GL_FALSE, view.entries);
+    glUniformMatrix4fv(r.overlayProjection, 1, GL_FALSE, projection.entries);
+    glUniformMatrix4fv(r.overlayModel,      1, GL_FALSE, identity.entries);
     glBindVertexArray(r.VAO);
-    // For occupied outlines:
-    //glUniform4f(glGetUniformLocation(r.shader, "uColor"), 0.8f, 0.8f, 0.8f, 0.30f);
-
-    // For selected cell:
-    //glUniform4f(glGetUniformLocation(r.shader, "uColor"), 1.0f, 0.9f, 0.1f, 0.25f);
-    FlushBuffer(r, {0.0f, 0.0f, 0.0f}, 0.0f);
-    glDepthMask(GL_TRUE);
-  }
-
-  // --- Pass 4: selected-cell highlight (semi-transparent yellow) ---
-  if (showSelectedCell && grid) {
-    const CellFeature& cf = grid->GetCell(grid->selX, grid->selY, grid->selZ);
-    bool cellEmpty = cf.feature == Feature::EMPTY;
-    bool inPreview = previewObjs;
-    
-    Vec3 identAxes[3] = {{1,0,0},{0,1,0},{0,0,1}};
-    constexpr float h = CELL_SIZE * 0.5f - 0.001f;
-    Vec3 sel = grid->CellCenterWorld(grid->selX, grid->selY, grid->selZ);
-    glDisable(GL_DEPTH_TEST);
-    AppendBox(r.buffer, sel, {h, h, h}, identAxes, {1.0f, 0.9f, 0.1f}, 0.25f);
-    FlushBuffer(r, {0.8f, 0.8f, 0.8f}, 0.2f);
-    glEnable(GL_DEPTH_TEST);
+    if (r.outlineVertices > 0) {
+      glDepthMask(GL_FALSE);
+      glDrawArrays(GL_TRIANGLES, 0, r.outlineVertices);
+      glDepthMask(GL_TRUE);
+    }
+    if (r.selectedVertices > 0) {
+      glDisable(GL_DEPTH_TEST);
+      glDrawArrays(GL_TRIANGLES, r.outlineVertices, r.selectedVertices);
+      glEnable(GL_DEPTH_TEST);
+    }
+    glBindVertexArray(0);
   }
 
   if (!colliders.empty()) {
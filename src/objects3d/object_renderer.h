@@ -11,15 +11,43 @@ struct MeshData {
   std::vector<unsigned int> indices;
   unsigned int VAO = 0, VBO = 0, EBO = 0;
   int indexCount = 0;
+  // This mesh's run in ObjectRenderer::instances
+  int instanceFirst = 0, instanceCount = 0;
+};
+
+// One object in the instanced solid pass
+struct ObjectInstance {
+  float model[16];
+  float color[4];   // rgb, alpha
 };
 
 struct ObjectRenderer {
-  unsigned int VAO    = 0;
+  unsigned int VAO    = 0;   // overlay geometry, 10 floats per vertex
   unsigned int VBO    = 0;
   unsigned int shader = 0;
+  unsigned int instancedShader = 0;
   unsigned int overlayShader = 0;
-  std::vector<float> buffer; // rebuilt each frame on CPU
+  std::vector<float> buffer; // overlay vertices, rebuilt with the overlay
   std::unordered_map<std::string, MeshData> loadedMeshes;
+
+  // Active objects grouped by mesh, one instanced draw per mesh. Rebuilt
+  // and uploaded only when an object differs from builtObjects.
+  std::vector<ObjectInstance> instances;
+  std::vector<RGObject>       builtObjects;
+  unsigned int instanceVBO      = 0;
+  size_t       instanceCapacity = 0;   // ObjectInstances the buffer holds
+
+  // Occupied outlines then the selected cell in VBO, rebuilt only when the
+  // grid, the selection or the toggles change
+  uint64_t overlayRevision  = 0;
+  int      overlaySel[3]    = {};
+  bool     overlayOutlines  = false, overlaySelected = false;
+  bool     overlayBuilt     = false;
+  int      outlineVertices  = 0, selectedVertices = 0;
+
+  // uniform locations, looked up once
+  int instancedView = -1, instancedProjection = -1, instancedCameraPos = -1;
+  int overlayView = -1, overlayProjection = -1, overlayModel = -1;
 };
 
 void SetupObjectRenderer(ObjectRenderer &r);
@@ -32,10 +60,10 @@ void AppendBox(std::vector<float>& buf,
                Vec3 color, float alpha);
 
 // Render all active objects, optional ghost preview, optional cell overlays.
-// previewObjs: null = no ghost pass; grid: null = no cell overlays.
+// previewObj: null = no ghost pass; grid: null = no cell overlays.
 void RenderObjects(ObjectRenderer& r,
-                   RGObject* objects,
-                   RGObject* previewObjs,
+                   const std::vector<RGObject>& objects,
+                   const RGObject* previewObj,
                    const GridState* grid,
                    bool showSelectedCell,
                    bool showOccupiedOutlines,
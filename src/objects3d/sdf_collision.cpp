@@ -1,11 +1,86 @@
 #include "sdf_collision.h"
+#include "sdf_volume.h"
+#include "triangle_bvh.h"
+#include "../sim_thread.h"
+#include <algorithm>
 #include <cstring>
+#include <utility>
+#include <vector>
 
+void ColliderRegistry::Set(size_t idx, const SDFCollider& collider) {
+  if (idx >= slots.size()) {
+    slots.resize(idx + 1, SDFCollider{});
+    dirty.resize(idx + 1, false);
+    resized = true;
+  } else if (std::memcmp(&slots[idx], &collider, sizeof(SDFCollider)) == 0) {
+    return;
+  }
+  slots[idx] = collider;
+  dirtyCount += !dirty[idx];
+  dirty[idx] = true;
+}
+
+void ColliderRegistry::Resize(size_t count) {
+  if (count == slots.size())
+    return;
+  for (size_t j = count; j < dirty.size(); ++j)
+    dirtyCount -= dirty[j];
+  slots.resize(count, SDFCollider{});
+  dirty.resize(count, false);
+  resized = true;
+}
+
+// The simulation steps on its own copy of the colliders; the batch reaches
+// it through the command queue, between two steps
+void ColliderRegistry::Flush(AppState* as) {
+  // without a simulation yet, the flags wait for the first one
+  if ((dirtyCount == 0 && !resized) || !as || !as->simThread)
+    return;
+  std::vector<std::pair<int, SDFCollider>> changes;
+  changes.reserve(dirtyCount);
+  for (size_t j = 0; j < slots.size(); ++j)
+    if (dirty[j])
+      changes.emplace_back((int)j, slots[j]);
+  std::fill(dirty.begin(), dirty.end(), false);
+  dirtyCount = 0;
+  resized    = false;
+
+  const size_t count = slots.size();
+  as->simThread->Post([changes = std::move(changes), count, as](Particles&,
+                                                                std::vector<SDFCollider>& simColliders) {
+    simColliders.resize(count, SDFCollider{});
+    for (const auto& [idx, collider] : changes)
+      simColliders[idx] = collider;
+#ifdef USE_CUDA
+    CudaBuffers& cb = *as->cudaBuffers;
+    cb.colliderCount = (int)count;
+    if (count > cb.colliderCapacity) {
+      // the device array only grows; refill it whole
+      cb.ReserveColliders(count);
+      cudaMemcpy(cb.colliders_d, simColliders.data(), sizeof(SDFCollider) * count,
+                 cudaMemcpyHostToDevice);
+      return;
+    }
+    // one copy per run of consecutive slots rather than the whole array
+    for (size_t first = 0; first < changes.size();) {
+      size_t last = first;
+      while (last + 1 < changes.size() && changes[last + 1].first == changes[last].first + 1)
+        ++last;
+      const int idx = changes[first].first;
+      cudaMemcpy(cb.colliders_d + idx, simColliders.data() + idx,
+                 sizeof(SDFCollider) * (last - first + 1), cudaMemcpyHostToDevice);
+      first = last + 1;
+    }
+#else
+    (void)as;
+#endif
+  });
+}
 
-void addCollider(SDFCollider* colliders, RGObject* objects, size_t idx,  AppState* as) {
-  if (idx > MAX_OBJECTS-1)
+void addCollider(ColliderRegistry& colliders, const std::vector<RGObject>& objects, size_t idx) {
+  if (idx >= objects.size())
     return;
-  RGObject rgObject = objects[idx];
+  const RGObject& rgObject = objects[idx];
   Mat4 rotationMatrix = CreateMatrixRotationXYZ(rgObject.rotation);
   Vec3 axes[3] = {TransformDir(rotationMatrix, {1, 0, 0}),
                   TransformDir(rotationMatrix, {0, 1, 0}),
@@ -17,45 +92,82 @@ void addCollider(SDFCollider* colliders, RGObject* objects, size_t idx,  AppStat
   memcpy(collider.rotationAxes, axes, sizeof(axes));
   collider.restitution = energyRetention;
 
-  colliders[idx] = collider;
-#ifdef USE_CUDA
-  CudaBuffers& cb = *as->cudaBuffers;
-  cudaMemcpy(cb.colliders_d, colliders, sizeof(SDFCollider) * MAX_OBJECTS,
-             cudaMemcpyHostToDevice);
-  //printf("Memory updated too!\n");
-#endif
+  colliders.Set(idx, collider);
 }
 
-void deleteCollider(SDFCollider* colliders, size_t idx, AppState *as) {
-  colliders[idx] = SDFCollider{};
-#ifdef USE_CUDA
-  CudaBuffers& cb = *as->cudaBuffers;
-  cudaMemcpy(cb.colliders_d, colliders, sizeof(SDFCollider) * MAX_OBJECTS,
-             cudaMemcpyHostToDevice);
-  //printf("Memory updated!\n");
-#endif
+void deleteCollider(ColliderRegistry& colliders, size_t idx) {
+  colliders.Clear(idx);
+}
+
+static void PushOut(Vec3& position, Vec3& velocity, const SDFCollider& collider,
+                    const Vec3& localGradient, float pushDistance) {
+  Vec3 worldGradient = collider.rotationAxes[0] * localGradient.x +
+                       collider.rotationAxes[1] * localGradient.y +
+                       collider.rotationAxes[2] * localGradient.z;
+  position += worldGradient * (-pushDistance + 0.002f);
+  float velocityDot = velocity.Dot(worldGradient);
+  if (velocityDot < 0.0f)
+    velocity -= worldGradient * ((1.0f + collider.restitution) * velocityDot);
 }
 
-void ProjectParticleSDF(Vec3& position, Vec3& velocity, const SDFCollider &collider) {
+static Vec3 SDFToLocal(const Vec3& position, const SDFCollider& collider) {
   Vec3 d = position - collider.worldPosition;
-  Vec3 localPosition = {
+  return Vec3{
     d.Dot(collider.rotationAxes[0]),
     d.Dot(collider.rotationAxes[1]),
     d.Dot(collider.rotationAxes[2])
   };
+}
+
+float SDFColliderDistance(const Vec3& position, const SDFCollider& collider) {
+  Vec3 localPosition = SDFToLocal(position, collider);
+  if (const SDFVolume* volume = BakedSDFVolume(collider.type)) {
+    float distance;
+    Vec3  gradient;
+    return volume->Sample(localPosition, distance, gradient) ? distance : 1e9f;
+  }
+  return sdfDispatch(collider.type, localPosition);
+}
 
-  float pushDistance = sdfDispatch(collider.type, localPosition);
+float ProjectParticleSDF(Vec3& position, Vec3& velocity, const SDFCollider &collider) {
+  Vec3 localPosition = SDFToLocal(position, collider);
+
+  float pushDistance;
+  if (const SDFVolume* volume = BakedSDFVolume(collider.type)) {
+    Vec3 localGradient;
+    if (!volume->Sample(localPosition, pushDistance, localGradient))
+      return volume->DistanceBound(localPosition, 1e9f);
+    if (pushDistance >= 0.0f)
+      return volume->DistanceBound(localPosition, pushDistance);
+    PushOut(position, velocity, collider, localGradient, pushDistance);
+    return pushDistance;
+  }
+  // most queries do not penetrate, and the plain distance is the cheaper
+  // test; the gradient only runs for the ones that do. The CSG of exact
+  // distances shrinks at most one unit per unit moved, so it is its own bound.
+  pushDistance = sdfDispatch(collider.type, localPosition);
   if (pushDistance >= 0.0f)
-    return;
+    return pushDistance;
+  ResolveSDFPenetration(position, velocity, collider, localPosition, pushDistance);
+  return pushDistance;
+}
 
-  Vec3 localGradient = sdfGradient(collider.type, localPosition);
-  Vec3 worldGradient = collider.rotationAxes[0] * localGradient.x +
-                       collider.rotationAxes[1] * localGradient.y +
-                       collider.rotationAxes[2] * localGradient.z;
-  position += worldGradient * (-pushDistance + 0.002f);
-  float velocityDot = velocity.Dot(worldGradient);
-  if (velocityDot < 0.0f)
-    velocity -= worldGradient * ((1.0f + collider.restitution) * velocityDot);
+void ResolveSDFPenetration(Vec3& position, Vec3& velocity, const SDFCollider& collider,
+                           const Vec3& localPosition, float pushDistance) {
+  Vec3 localGradient;
+  if (const SDFVolume* volume = BakedSDFVolume(collider.type)) {
+    float distance;
+    volume->Sample(localPosition, distance, localGradient);
+  } else if (sdfGradientMode == SDFGradient::ANALYTIC) {
+    Vec3 gradient = sdfDispatchGrad(collider.type, localPosition).gradient;
+    float length = gradient.Magnitude();
+    if (length == 0.0f)
+      return;
+    localGradient = gradient / length;
+  } else {
+    localGradient = sdfGradient(collider.type, localPosition);
+  }
+  PushOut(position, velocity, collider, localGradient, pushDistance);
 }
 
 std::vector<Vec3> SampleSDFInside(const SDFCollider &collider, float gridStep) {
@@ -80,22 +192,61 @@ std::vector<Vec3> SampleSDFInside(const SDFCollider &collider, float gridStep) {
   return insidePoints;
 }
 
+static Vec3 TriToLocal(const TriCollider& collider, const Vec3& p) {
+  Vec3 d = p - collider.worldPosition;
+  return {d.Dot(collider.rotationAxes[0]), d.Dot(collider.rotationAxes[1]),
+          d.Dot(collider.rotationAxes[2])};
+}
+
+static Vec3 TriToWorldDir(const TriCollider& collider, const Vec3& v) {
+  return collider.rotationAxes[0] * v.x + collider.rotationAxes[1] * v.y +
+         collider.rotationAxes[2] * v.z;
+}
+
 void ProjectParticleTri(const Vec3 &p, const Vec3 &velocity,
                         const TriCollider& triCollider,Vec3& closestPointOut) {
   float minDistanceSquared = std::numeric_limits<float>::infinity();
   Vec3 closestPoint = Vec3{0.0f, 0.0f, 0.0f};
+  Vec3 localPosition = TriToLocal(triCollider, p);
 
   for (size_t i = 0; i + 2 < triCollider.count; i += 3) {
-    Vec3 q = ClosestPtPointTriangle(p, triCollider.triangles[i],
+    Vec3 q = ClosestPtPointTriangle(localPosition, triCollider.triangles[i],
                                     triCollider.triangles[i + 1],
                                     triCollider.triangles[i + 2]);
     
-    Vec3 diff = p - q;
+    Vec3 diff = localPosition - q;
     float distanceSquared = diff.Dot(diff);
     if (distanceSquared < minDistanceSquared) {
       minDistanceSquared = distanceSquared;
       closestPoint = q;
     }
   }
-  closestPointOut = closestPoint;
+  closestPointOut = triCollider.worldPosition + TriToWorldDir(triCollider, closestPoint);
+}
+
+// Closest point through the collider's BVH, then the same push out and
+// velocity reflection as ProjectParticleSDF when the particle is inside the
+// mesh. closestPointOut is only written for particles within the mesh's box.
+void ProjectParticleTriBVH(Vec3 &position, Vec3 &velocity,
+                           const TriCollider& triCollider, Vec3& closestPointOut) {
+  const TriangleBVH& bvh = *triCollider.bvh;
+  Vec3 localPosition = TriToLocal(triCollider, position);
+  if (bvh.Empty() || !bvh.BoundsContain(localPosition))
+    return;
+  TriangleHit hit;
+  if (!bvh.Closest(localPosition, std::numeric_limits<float>::infinity(), hit))
+    return;
+  Vec3 worldPoint = triCollider.worldPosition + TriToWorldDir(triCollider, hit.point);
+  closestPointOut = worldPoint;
+
+  Vec3 toSurface = hit.point - localPosition;
+  if (toSurface.Dot(hit.normal) <= 0.0f)
+    return;
+  // inside: leave along the shortest way out, the face normal when on it
+  float depth = std::sqrt(hit.distanceSquared);
+  Vec3 normal = TriToWorldDir(triCollider, depth > 1e-7f ? toSurface / depth : hit.normal);
+  position = worldPoint + normal * 0.002f;
+  float velocityDot = velocity.Dot(normal);
+  if (velocityDot < 0.0f)
+    velocity -= normal * ((1.0f + triCollider.restitution) * velocityDot);
 }
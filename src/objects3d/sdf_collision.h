@@ -11,18 +11,30 @@
 #include "../cuda_buffers.cuh"
 #endif
 
-void addCollider(SDFCollider *colliders, RGObject *objects, size_t idx,
-                 AppState *as);
+// Stage the collider for objects[idx] / an empty slot; reaches the
+// simulation on the registry's next Flush()
+void addCollider(ColliderRegistry& colliders, const std::vector<RGObject>& objects, size_t idx);
 
-void deleteCollider(SDFCollider* colliders, size_t idx, AppState* as);
+void deleteCollider(ColliderRegistry& colliders, size_t idx);
 
 void BuildSDFColliders(const std::vector<RGObject>& objects, std::vector<SDFCollider>& colliders);
 
-void ProjectParticleSDF(Vec3& position, Vec3& velocity, const SDFCollider& collider);
+// Pushes the particle out of collider. Returns a lower bound on its
+// distance to the collider before the push (negative when it was inside),
+// for CollisionBound.
+float ProjectParticleSDF(Vec3& position, Vec3& velocity, const SDFCollider& collider);
+// Signed distance the collision pass sees at position, without pushing
+float SDFColliderDistance(const Vec3& position, const SDFCollider& collider);
+// Second half of ProjectParticleSDF for a particle already found
+// pushDistance (< 0) inside collider at localPosition
+void ResolveSDFPenetration(Vec3& position, Vec3& velocity, const SDFCollider& collider,
+                           const Vec3& localPosition, float pushDistance);
 std::vector<Vec3> SampleSDFInside(const SDFCollider &collider, float gridStep);
 
 void ProjectParticleTri(const Vec3 &p, const Vec3 &velocity,
                         const TriCollider &triCollider, Vec3 &closestPointOut);
+void ProjectParticleTriBVH(Vec3 &position, Vec3 &velocity,
+                           const TriCollider &triCollider, Vec3 &closestPointOut);
 Vec3 ClosestPtPointTriangle(const Vec3 &p, const Vec3 &a, const Vec3 &b,
                             const Vec3 &c);
 
@@ -164,6 +176,183 @@ inline Vec3 sdfGradient(RGObjectType type, Vec3 localPosition) {
   return Normalize(grad);
 }
 
+// ---------------------------------------------------------------------------
+// Distance and gradient together. Each shape above has a *Grad twin that
+// carries d(distance)/d(position) through the same CSG: min/max pick the
+// gradient of the winning operand, negation flips it, and reflections or
+// rotations of p map it back with the transposed transform. One evaluation
+// replaces the six of sdfGradient. Gradients are not normalised;
+// sdfGradient stays as the finite-difference reference.
+struct SDFSample {
+  float distance;
+  Vec3  gradient;
+};
+
+// Per-component selects so the compiler emits blends, not branches that
+// mispredict on every other particle
+DEVICE_CALLABLE
+inline SDFSample sdfSelect(bool pickA, const SDFSample& a, const SDFSample& b) {
+  return {pickA ? a.distance : b.distance,
+          Vec3{pickA ? a.gradient.x : b.gradient.x,
+               pickA ? a.gradient.y : b.gradient.y,
+               pickA ? a.gradient.z : b.gradient.z}};
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfMax(const SDFSample& a, const SDFSample& b) { return sdfSelect(a.distance >= b.distance, a, b); }
+
+DEVICE_CALLABLE
+inline SDFSample sdfMin(const SDFSample& a, const SDFSample& b) { return sdfSelect(a.distance <= b.distance, a, b); }
+
+DEVICE_CALLABLE
+inline SDFSample sdfNegate(const SDFSample& a) { return {-a.distance, a.gradient * -1.0f}; }
+
+// -p.n, the half space behind a plane through the origin
+DEVICE_CALLABLE
+inline SDFSample sdfHalfSpace(Vec3 p, Vec3 n) { return {-p.Dot(n), n * -1.0f}; }
+
+// v / length, zero on the axis where the direction is undefined
+DEVICE_CALLABLE
+inline Vec3 sdfSafeDirection(Vec3 v, float length) {
+  return v * (1.0f / max(length, 1e-12f));
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfCappedCylinderGrad(Vec3 p, float radius, float halfHeight) {
+  float rxy = Vec2{p.x, p.y}.Magnitude();
+  SDFSample radial{rxy - radius, sdfSafeDirection(Vec3{p.x, p.y, 0.0f}, rxy)};
+  SDFSample axial{abs(p.z) - halfHeight, Vec3{0.0f, 0.0f, copysignf(1.0f, p.z)}};
+  float dx = max(radial.distance, 0.0f);
+  float dy = max(axial.distance, 0.0f);
+  float length = Vec2{dx, dy}.Magnitude();
+  SDFSample outside{length, sdfSafeDirection(radial.gradient * dx + axial.gradient * dy, length)};
+  return sdfSelect(length > 0.0f, outside, sdfMax(radial, axial));
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfTorusGrad(Vec3 p, Vec2 t) {
+  float rxz = Vec2{p.x, p.z}.Magnitude();
+  Vec2 q{rxz - t.x, p.y};
+  float length = q.Magnitude();
+  Vec3 dqx = sdfSafeDirection(Vec3{p.x, 0.0f, p.z}, rxz);
+  return {length - t.y, sdfSafeDirection(dqx * q.x + Vec3{0.0f, q.y, 0.0f}, length)};
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfTorusXGrad(Vec3 p, Vec2 t) {
+  float ryz = Vec2{p.y, p.z}.Magnitude();
+  Vec2 q{ryz - t.x, p.x};
+  float length = q.Magnitude();
+  Vec3 dqx = sdfSafeDirection(Vec3{0.0f, p.y, p.z}, ryz);
+  return {length - t.y, sdfSafeDirection(dqx * q.x + Vec3{q.y, 0.0f, 0.0f}, length)};
+}
+
+// The cut planes are the fixed ones of sdfWedgeShell, whose wedgeAngle does
+// not reach them, so the gradient twins take no angle.
+DEVICE_CALLABLE
+inline SDFSample sdfWedgeShellGrad(Vec3 p, float outerRadius, float innerRadius) {
+  float r = p.Magnitude();
+  Vec3 dr = sdfSafeDirection(p, r);
+  SDFSample outer{r - outerRadius, dr};
+  SDFSample inner{r - innerRadius, dr};
+  SDFSample shell = sdfMax(outer, sdfNegate(inner));
+
+  Vec3 n1{0.0f, 0.0f, -1.0};
+  Vec3 n2{0.0f, 0.8f, 0.6f};
+  return sdfMax(sdfMax(shell, sdfHalfSpace(p, n1)), sdfHalfSpace(p, n2));
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfTorusWedgeShellGrad(Vec3 p, float majorRadius, float outerRadius, float innerRadius) {
+  SDFSample outer = sdfTorusXGrad(p, Vec2{majorRadius, outerRadius});
+  SDFSample inner = sdfTorusXGrad(p, Vec2{majorRadius, innerRadius});
+  SDFSample shell = sdfMax(outer, sdfNegate(inner));
+
+  Vec3 n1{0.0f, 0.0f, -1.0};
+  Vec3 n2{0.0f, 0.8f, 0.6f};
+
+  float ryz = Vec2{p.y, p.z}.Magnitude();
+  SDFSample tube{ryz - majorRadius, sdfSafeDirection(Vec3{0.0f, p.y, p.z}, ryz)};
+  SDFSample cut = sdfMax(shell, tube);
+  return sdfMax(sdfMax(cut, sdfHalfSpace(p, n1)), sdfHalfSpace(p, n2));
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfLChannelGrad(Vec3 p) {
+  constexpr float majorRadius = 0.2f;
+  constexpr float outerRadius = 0.2f;
+  constexpr float wall = 0.08f;
+  constexpr float innerRadius = outerRadius - wall;
+
+  Vec3 pTorus = p - Vec3{-0.2f, 0.0f, 0.2f};
+  SDFSample outer = sdfTorusGrad(pTorus, Vec2{majorRadius, outerRadius});
+  SDFSample inner = sdfTorusGrad(pTorus, Vec2{majorRadius, innerRadius});
+  SDFSample shell = sdfMax(outer, sdfNegate(inner));
+
+  SDFSample quarter = sdfMax(sdfMax(shell, SDFSample{-pTorus.x, Vec3{-1.0f, 0.0f, 0.0f}}),
+                             SDFSample{pTorus.z, Vec3{0.0f, 0.0f, 1.0f}});
+  return sdfMax(quarter, SDFSample{pTorus.y, Vec3{0.0f, 1.0f, 0.0f}});
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfSChannelGrad(Vec3 p) {
+  constexpr float outerRadius = 0.2f;
+  constexpr float wall = 0.08f;
+  constexpr float halfLength = 0.205f;
+  constexpr float innerRadius = outerRadius - wall;
+
+  SDFSample outer = sdfCappedCylinderGrad(p, outerRadius, halfLength);
+  SDFSample inner = sdfCappedCylinderGrad(p, innerRadius, halfLength + 0.001f);
+  SDFSample shell = sdfMax(outer, sdfNegate(inner));
+  return sdfMax(shell, SDFSample{p.y, Vec3{0.0f, 1.0f, 0.0f}});
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfBRampGrad(Vec3 p) {
+  constexpr float c = 0.6f;
+  constexpr float s = 0.8f;
+  constexpr float outerRadius = 0.193f;
+  constexpr float majorRadius = 0.193f;
+  constexpr float wall = 0.08f;
+  constexpr float innerRadius = outerRadius - wall;
+
+  p.z = -p.z;
+  Vec3 pLocal = p - Vec3{0.0f, 0.157f, 0.09f};
+  Vec3 pRotated{pLocal.x, pLocal.y * c + pLocal.z * s,
+                -pLocal.y * s + pLocal.z * c};
+  SDFSample mid = sdfSChannelGrad(pRotated);
+  Vec3 g = mid.gradient;
+  mid.gradient = Vec3{g.x, g.y * c - g.z * s, g.y * s + g.z * c};
+
+  Vec3 pS1 = p - Vec3{0.0f, 0.0f, 0.21f};
+  pS1.y = -pS1.y;
+  SDFSample s1 = sdfWedgeShellGrad(pS1, outerRadius, innerRadius);
+  s1.gradient.y = -s1.gradient.y;
+
+  Vec3 pS2 = p - Vec3{0.0f, 0.20f, -0.2f};
+  pS2.z = -pS2.z;
+  SDFSample s2 = sdfTorusWedgeShellGrad(pS2, majorRadius, outerRadius, innerRadius);
+  s2.gradient.z = -s2.gradient.z;
+
+  SDFSample result = sdfMin(sdfMin(mid, s1), s2);
+  result.gradient.z = -result.gradient.z;
+  return result;
+}
+
+DEVICE_CALLABLE
+inline SDFSample sdfDispatchGrad(RGObjectType type, Vec3 localPosition) {
+  switch (type) {
+  case RGObjectType::S_CHANNEL:
+    return sdfSChannelGrad(localPosition);
+  case RGObjectType::L_CHANNEL:
+    return sdfLChannelGrad(localPosition);
+  case RGObjectType::RAMP:
+    return sdfBRampGrad(localPosition);
+  default:
+    return {1e9f, Vec3{0.0f, 0.0f, 0.0f}};
+  }
+}
+
 // Triangle Collision Benchmarking Functions
 
 // adapted from "Real-Time Collision Detection" by Christer Ericson
@@ -0,0 +1,173 @@
+#include "sdf_volume.h"
+#include "sdf_collision.h"
+#include "mesh_sdf.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+static SDFVolume volumes[RG_OBJECT_TYPES];   // indexed by RGObjectType
+static int       bakedResolution = 0;
+static std::string meshLoadedPath;   // OBJ behind the MESH volume, empty until one is used
+
+static const RGObjectType bakedTypes[] = {
+  RGObjectType::S_CHANNEL, RGObjectType::L_CHANNEL, RGObjectType::RAMP
+};
+
+// Local-space bounds of the shape's interior, found on a coarse scan. The
+// shapes are authored to fit a grid cell; scanning two cells each way
+// leaves room for ones that overhang.
+static void ScanInteriorBounds(RGObjectType type, Vec3& lo, Vec3& hi)
+{
+  const float step  = CELL_SIZE / 20.0f;
+  const float bound = CELL_SIZE * 2.0f;
+  lo = Vec3{ bound,  bound,  bound};
+  hi = Vec3{-bound, -bound, -bound};
+  for (float z = -bound; z <= bound; z += step)
+    for (float y = -bound; y <= bound; y += step)
+      for (float x = -bound; x <= bound; x += step) {
+        if (sdfDispatch(type, Vec3{x, y, z}) >= 0.0f) continue;
+        lo = Vec3{std::min(lo.x, x), std::min(lo.y, y), std::min(lo.z, z)};
+        hi = Vec3{std::max(hi.x, x), std::max(hi.y, y), std::max(hi.z, z)};
+      }
+  // one scan step may hide interior just past the last sample
+  lo = lo - Vec3{step, step, step};
+  hi = hi + Vec3{step, step, step};
+}
+
+bool SDFShapeBounds(RGObjectType type, Vec3& lo, Vec3& hi)
+{
+  struct Bounds { bool scanned = false, empty = true; Vec3 lo, hi; };
+  static Bounds cache[RG_OBJECT_TYPES];
+  if (type == RGObjectType::BOX) return false;
+  if (type == RGObjectType::MESH) {
+    // no analytic form to scan; the baked box bounds the mesh
+    const SDFVolume& volume = volumes[(int)type];
+    if (volume.distances.empty()) return false;
+    lo = volume.origin;
+    hi = volume.origin + Vec3{(float)(volume.nx - 1), (float)(volume.ny - 1),
+                              (float)(volume.nz - 1)} * volume.voxel;
+    return true;
+  }
+
+  Bounds& b = cache[(int)type];
+  if (!b.scanned) {
+    ScanInteriorBounds(type, b.lo, b.hi);
+    b.empty   = b.lo.x > b.hi.x;
+    b.scanned = true;
+  }
+  lo = b.lo;
+  hi = b.hi;
+  return !b.empty;
+}
+
+void SDFVolume::MeasureSlope()
+{
+  float steepest[3] = {0.0f, 0.0f, 0.0f};
+  const int sy = nx, sz = nx * ny;
+  for (int z = 0; z < nz; ++z)
+    for (int y = 0; y < ny; ++y)
+      for (int x = 0; x < nx; ++x) {
+        const float* n = &distances[x + y * sy + z * sz];
+        if (x + 1 < nx) steepest[0] = std::max(steepest[0], std::fabs(n[1] - n[0]));
+        if (y + 1 < ny) steepest[1] = std::max(steepest[1], std::fabs(n[sy] - n[0]));
+        if (z + 1 < nz) steepest[2] = std::max(steepest[2], std::fabs(n[sz] - n[0]));
+      }
+  slope = std::sqrt(steepest[0] * steepest[0] + steepest[1] * steepest[1] +
+                    steepest[2] * steepest[2]) * invVoxel;
+  // a flat grid never reports a hit; keep the division in DistanceBound finite
+  slope = std::max(slope, 1e-6f);
+}
+
+static void Bake(RGObjectType type, int resolution, SDFVolume& volume)
+{
+  Vec3 lo, hi;
+  if (!SDFShapeBounds(type, lo, hi)) return;
+  Vec3 size = hi - lo;
+  float longest = std::max(size.x, std::max(size.y, size.z));
+
+  // two voxels of margin so the trilinear stencil never reaches outside
+  volume.voxel    = longest / (float)(resolution - 1);
+  volume.invVoxel = 1.0f / volume.voxel;
+  const float margin = 2.0f * volume.voxel;
+  volume.origin = lo - Vec3{margin, margin, margin};
+  volume.nx = (int)std::ceil((size.x + 2.0f * margin) * volume.invVoxel) + 1;
+  volume.ny = (int)std::ceil((size.y + 2.0f * margin) * volume.invVoxel) + 1;
+  volume.nz = (int)std::ceil((size.z + 2.0f * margin) * volume.invVoxel) + 1;
+
+  volume.distances.resize((size_t)volume.nx * volume.ny * volume.nz);
+  size_t idx = 0;
+  for (int z = 0; z < volume.nz; ++z)
+    for (int y = 0; y < volume.ny; ++y)
+      for (int x = 0; x < volume.nx; ++x, ++idx) {
+        Vec3 p = volume.origin + Vec3{(float)x, (float)y, (float)z} * volume.voxel;
+        volume.distances[idx] = sdfDispatch(type, p);
+      }
+  volume.MeasureSlope();
+
+  // error at voxel centres within a few voxels of the surface, the only
+  // place where the collision pass acts on the distance
+  volume.maxError = 0.0f;
+  const float band = 4.0f * volume.voxel;
+  for (int z = 0; z + 1 < volume.nz; ++z)
+    for (int y = 0; y + 1 < volume.ny; ++y)
+      for (int x = 0; x + 1 < volume.nx; ++x) {
+        Vec3 p = volume.origin + Vec3{x + 0.5f, y + 0.5f, z + 0.5f} * volume.voxel;
+        float exact = sdfDispatch(type, p);
+        if (std::fabs(exact) > band) continue;
+        float baked;
+        Vec3  gradient;
+        if (volume.Sample(p, baked, gradient))
+          volume.maxError = std::max(volume.maxError, std::fabs(baked - exact));
+      }
+}
+
+bool EnsureSDFVolumes(int resolution, const SDFCollider* colliders, int count)
+{
+  bool changed = false;
+  // the mesh bake takes seconds, so it waits for the first MESH collider
+  if (meshLoadedPath != meshColliderPath &&
+      std::any_of(colliders, colliders + count,
+                  [](const SDFCollider& c) { return c.type == RGObjectType::MESH; })) {
+    meshLoadedPath = meshColliderPath;
+    LoadMeshSDF(meshLoadedPath, meshSDFResolution, volumes[(int)RGObjectType::MESH]);
+    changed = true;
+  }
+
+  if (resolution == bakedResolution) return changed;
+  bakedResolution = resolution;
+  for (RGObjectType type : bakedTypes)
+    volumes[(int)type] = SDFVolume{};
+  if (resolution <= 0) return true;
+
+  resolution = std::max(resolution, 4);
+  for (RGObjectType type : bakedTypes) {
+    SDFVolume& volume = volumes[(int)type];
+    Bake(type, resolution, volume);
+    std::cout << "SDF volume type " << (int)type << ": " << volume.nx << "x" << volume.ny
+              << "x" << volume.nz << ", max error " << volume.maxError << std::endl;
+  }
+  return true;
+}
+
+const SDFVolume* BakedSDFVolume(RGObjectType type)
+{
+  const SDFVolume& volume = volumes[(int)type];
+  return volume.distances.empty() ? nullptr : &volume;
+}
+
+float SDFVolumeMaxError()
+{
+  float maxError = 0.0f;
+  for (const SDFVolume& volume : volumes)
+    maxError = std::max(maxError, volume.maxError);
+  return maxError;
+}
+
+size_t SDFVolumeBytes()
+{
+  size_t bytes = 0;
+  for (const SDFVolume& volume : volumes)
+    bytes += volume.distances.size() * sizeof(float);
+  return bytes;
+}
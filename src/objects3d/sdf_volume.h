@@ -0,0 +1,122 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include "editor_state.h"
+#include "../linear_algebra.h"
+
+// Local-space distance grid baked from the analytic SDF of one RGObjectType
+// and shared by every collider of that type. The box covers the shape's
+// interior plus a margin, so a point outside it cannot be inside the shape.
+// Only distances are stored; the gradient is the derivative of the trilinear
+// interpolant, which keeps a node at 4 bytes and a lookup at 8 loads.
+struct SDFVolume {
+  Vec3  origin{0.0f, 0.0f, 0.0f};   // local-space position of node (0, 0, 0)
+  float voxel    = 0.0f;
+  float invVoxel = 0.0f;
+  int   nx = 0, ny = 0, nz = 0;     // nodes per axis
+  std::vector<float> distances;
+  float maxError = 0.0f;            // max |baked - analytic| distance near the surface
+  float slope    = 1.0f;            // bound on the interpolant's gradient length (see MeasureSlope)
+
+  // Trilinear lookup; false when p lies outside the baked box. gradient is
+  // only written when distance < 0, the only case collisions need it.
+  bool Sample(const Vec3& p, float& distance, Vec3& gradient) const {
+    float fx = (p.x - origin.x) * invVoxel;
+    float fy = (p.y - origin.y) * invVoxel;
+    float fz = (p.z - origin.z) * invVoxel;
+    if (!(fx >= 0.0f && fy >= 0.0f && fz >= 0.0f &&
+          fx < nx - 1 && fy < ny - 1 && fz < nz - 1))
+      return false;
+
+    int ix = (int)fx, iy = (int)fy, iz = (int)fz;
+    float tx = fx - ix, ty = fy - iy, tz = fz - iz;
+    const int sy = nx, sz = nx * ny;
+    const float* n = &distances[ix + iy * sy + iz * sz];
+    const float c000 = n[0],       c100 = n[1];
+    const float c010 = n[sy],      c110 = n[sy + 1];
+    const float c001 = n[sz],      c101 = n[sz + 1];
+    const float c011 = n[sy + sz], c111 = n[sy + sz + 1];
+
+    float x00 = c000 + (c100 - c000) * tx;
+    float x10 = c010 + (c110 - c010) * tx;
+    float x01 = c001 + (c101 - c001) * tx;
+    float x11 = c011 + (c111 - c011) * tx;
+    float y0  = x00 + (x10 - x00) * ty;
+    float y1  = x01 + (x11 - x01) * ty;
+    distance  = y0 + (y1 - y0) * tz;
+    if (distance >= 0.0f)
+      return true;
+
+    float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * ty;
+    float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * ty;
+    gradient = Normalize(Vec3{dx0 + (dx1 - dx0) * tz,
+                              (x10 - x00) + ((x11 - x01) - (x10 - x00)) * tz,
+                              y1 - y0});
+    return true;
+  }
+
+  // Distance alone, the same value Sample() gives, without branches so loops
+  // over many points can vectorise; points outside the box read as far away
+  float Distance(const Vec3& p) const {
+    float fx = (p.x - origin.x) * invVoxel;
+    float fy = (p.y - origin.y) * invVoxel;
+    float fz = (p.z - origin.z) * invVoxel;
+    const bool inside = fx >= 0.0f && fy >= 0.0f && fz >= 0.0f &&
+                        fx < nx - 1 && fy < ny - 1 && fz < nz - 1;
+    fx = inside ? fx : 0.0f;
+    fy = inside ? fy : 0.0f;
+    fz = inside ? fz : 0.0f;
+
+    int ix = (int)fx, iy = (int)fy, iz = (int)fz;
+    float tx = fx - ix, ty = fy - iy, tz = fz - iz;
+    const int sy = nx, sz = nx * ny;
+    const float* n = &distances[ix + iy * sy + iz * sz];
+    float x00 = n[0]       + (n[1]           - n[0])       * tx;
+    float x10 = n[sy]      + (n[sy + 1]      - n[sy])      * tx;
+    float x01 = n[sz]      + (n[sz + 1]      - n[sz])      * tx;
+    float x11 = n[sy + sz] + (n[sy + sz + 1] - n[sy + sz]) * tx;
+    float y0  = x00 + (x10 - x00) * ty;
+    float y1  = x01 + (x11 - x01) * ty;
+    float distance = y0 + (y1 - y0) * tz;
+    return inside ? distance : 1e9f;
+  }
+
+  // Lower bound on how far p is from the shape, given distance = Distance(p):
+  // no point closer to p than this is inside. Within the box the distance
+  // shrinks at most by slope per unit moved; outside it the shape is at
+  // least as far as the box.
+  float DistanceBound(const Vec3& p, float distance) const {
+    if (distance < 1e9f)
+      return distance / slope;
+    Vec3 hi = origin + Vec3{(float)(nx - 1), (float)(ny - 1), (float)(nz - 1)} * voxel;
+    float dx = std::fmax(std::fmax(origin.x - p.x, p.x - hi.x), 0.0f);
+    float dy = std::fmax(std::fmax(origin.y - p.y, p.y - hi.y), 0.0f);
+    float dz = std::fmax(std::fmax(origin.z - p.z, p.z - hi.z), 0.0f);
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+  }
+
+  // Sets slope from the nodes: each gradient component of the trilinear
+  // interpolant is a blend of node differences along its axis, so the
+  // largest difference per axis bounds it. Call after filling distances.
+  void MeasureSlope();
+};
+
+// Re-bakes every shape when resolution (nodes along the longest axis)
+// changed since the last call; 0 frees the volumes and selects the analytic
+// SDF. The MESH volume, which has no analytic form and stays at
+// meshSDFResolution, is loaded once colliders holds a MESH collider and again
+// when meshColliderPath changes. True when any volume changed. Not
+// thread-safe: call before the collision pass, not inside it.
+bool EnsureSDFVolumes(int resolution, const SDFCollider* colliders, int count);
+
+// Baked volume for type, nullptr when volumes are off or type has no shape
+const SDFVolume* BakedSDFVolume(RGObjectType type);
+
+// Local-space box around the interior of type's shape (scanned once and
+// cached); false for shapes without an interior such as empty BOX slots.
+// Not thread-safe on first use per type.
+bool SDFShapeBounds(RGObjectType type, Vec3& lo, Vec3& hi);
+
+// Largest maxError over the baked shapes
+float SDFVolumeMaxError();
+size_t SDFVolumeBytes();
@@ -0,0 +1,236 @@
+#include "triangle_bvh.h"
+#include "sdf_collision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static float Component(const Vec3& v, int axis)
+{
+  return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static Vec3 Min(const Vec3& a, const Vec3& b)
+{
+  return Vec3{std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+
+static Vec3 Max(const Vec3& a, const Vec3& b)
+{
+  return Vec3{std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+
+static float HalfArea(const Vec3& lo, const Vec3& hi)
+{
+  Vec3 e = hi - lo;
+  return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// Squared distance from p to the node's box, 0 inside it
+static float BoxDistanceSquared(const BVHNode& node, const Vec3& p)
+{
+  float dx = std::max(std::max(node.boundsMin.x - p.x, p.x - node.boundsMax.x), 0.0f);
+  float dy = std::max(std::max(node.boundsMin.y - p.y, p.y - node.boundsMax.y), 0.0f);
+  float dz = std::max(std::max(node.boundsMin.z - p.z, p.z - node.boundsMax.z), 0.0f);
+  return dx * dx + dy * dy + dz * dz;
+}
+
+struct Bin {
+  Vec3 lo{ std::numeric_limits<float>::max(),  std::numeric_limits<float>::max(),
+           std::numeric_limits<float>::max()};
+  Vec3 hi{-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+          -std::numeric_limits<float>::max()};
+  int  count = 0;
+
+  void Grow(const Vec3& a, const Vec3& b, const Vec3& c) {
+    lo = Min(lo, Min(a, Min(b, c)));
+    hi = Max(hi, Max(a, Max(b, c)));
+  }
+  void Grow(const Bin& o) {
+    lo = Min(lo, o.lo);
+    hi = Max(hi, o.hi);
+    count += o.count;
+  }
+};
+
+void TriangleBVH::Build(const Vec3* triangles, size_t count)
+{
+  nodes.clear();
+  vertices.clear();
+  normals.clear();
+  const int numTriangles = (int)(count / 3);
+  if (numTriangles == 0) return;
+
+  std::vector<int>  order(numTriangles);
+  std::vector<Vec3> centroids(numTriangles);
+  float signedVolume = 0.0f;
+  for (int t = 0; t < numTriangles; ++t) {
+    const Vec3& a = triangles[3 * t];
+    const Vec3& b = triangles[3 * t + 1];
+    const Vec3& c = triangles[3 * t + 2];
+    order[t]     = t;
+    centroids[t] = (a + b + c) * (1.0f / 3.0f);
+    signedVolume += a.Dot(Cross(b, c));
+  }
+
+  nodes.reserve(2 * numTriangles);
+  nodes.push_back(BVHNode{{}, 0, {}, numTriangles});
+  Subdivide(0, order, centroids, triangles, 0);
+
+  // counter-clockwise triangles enclose a positive volume; the Y/Z swap of
+  // the OBJ loader mirrors the mesh and turns that around
+  const float orientation = signedVolume < 0.0f ? -1.0f : 1.0f;
+  vertices.resize(3 * (size_t)numTriangles);
+  normals.resize(numTriangles);
+  for (int t = 0; t < numTriangles; ++t) {
+    const Vec3* tri = &triangles[3 * order[t]];
+    vertices[3 * t]     = tri[0];
+    vertices[3 * t + 1] = tri[1];
+    vertices[3 * t + 2] = tri[2];
+    Vec3 n = Cross(tri[1] - tri[0], tri[2] - tri[0]);
+    float length = n.Magnitude();
+    normals[t] = length > 0.0f ? n * (orientation / length) : Vec3{0.0f, 0.0f, 0.0f};
+  }
+}
+
+void TriangleBVH::Subdivide(int index, std::vector<int>& order, const std::vector<Vec3>& centroids,
+                           const Vec3* triangles, int depth)
+{
+  const int first = nodes[index].first;
+  const int count = nodes[index].count;
+
+  Bin all, centroidBounds;
+  for (int i = first; i < first + count; ++i) {
+    const Vec3* tri = &triangles[3 * order[i]];
+    all.Grow(tri[0], tri[1], tri[2]);
+    centroidBounds.Grow(centroids[order[i]], centroids[order[i]], centroids[order[i]]);
+  }
+  nodes[index].boundsMin = all.lo;
+  nodes[index].boundsMax = all.hi;
+  // the stack in Closest() holds one pending sibling per level
+  if (count <= BVH_LEAF_TRIANGLES || depth + 1 >= BVH_MAX_DEPTH) return;
+
+  // binned SAH: cost of a split is sum(area * triangles) of the two halves
+  float bestCost = HalfArea(all.lo, all.hi) * (float)count;
+  int   bestAxis = -1, bestSplit = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    float lo = Component(centroidBounds.lo, axis);
+    float hi = Component(centroidBounds.hi, axis);
+    if (hi <= lo) continue;
+    float scale = BVH_SAH_BINS / (hi - lo);
+
+    Bin bins[BVH_SAH_BINS];
+    for (int i = first; i < first + count; ++i) {
+      int b = std::min(BVH_SAH_BINS - 1, (int)((Component(centroids[order[i]], axis) - lo) * scale));
+      const Vec3* tri = &triangles[3 * order[i]];
+      bins[b].Grow(tri[0], tri[1], tri[2]);
+      bins[b].count++;
+    }
+
+    // sweep from the right, then from the left, scoring each bin boundary
+    float rightCost[BVH_SAH_BINS - 1];
+    Bin right;
+    for (int b = BVH_SAH_BINS - 1; b > 0; --b) {
+      right.Grow(bins[b]);
+      rightCost[b - 1] = right.count ? HalfArea(right.lo, right.hi) * (float)right.count : 0.0f;
+    }
+    Bin left;
+    for (int b = 0; b < BVH_SAH_BINS - 1; ++b) {
+      left.Grow(bins[b]);
+      if (left.count == 0 || left.count == count) continue;
+      float cost = HalfArea(left.lo, left.hi) * (float)left.count + rightCost[b];
+      if (cost < bestCost) {
+        bestCost  = cost;
+        bestAxis  = axis;
+        bestSplit = b + 1;
+      }
+    }
+  }
+  if (bestAxis < 0) return;
+
+  float lo    = Component(centroidBounds.lo, bestAxis);
+  float scale = BVH_SAH_BINS / (Component(centroidBounds.hi, bestAxis) - lo);
+  int*  middle = std::partition(order.data() + first, order.data() + first + count, [&](int t) {
+    return std::min(BVH_SAH_BINS - 1, (int)((Component(centroids[t], bestAxis) - lo) * scale)) < bestSplit;
+  });
+  const int leftCount = (int)(middle - (order.data() + first));
+
+  const int leftChild = (int)nodes.size();
+  nodes.push_back(BVHNode{{}, first, {}, leftCount});
+  nodes.push_back(BVHNode{{}, first + leftCount, {}, count - leftCount});
+  nodes[index].first = leftChild;
+  nodes[index].count = 0;
+  Subdivide(leftChild, order, centroids, triangles, depth + 1);
+  Subdivide(leftChild + 1, order, centroids, triangles, depth + 1);
+}
+
+// Squared distances within this of best are the same edge or vertex reached
+// through another triangle, up to rounding
+static float TieSlack(float bestDistanceSquared)
+{
+  return 2.0f * BVH_TIE_DISTANCE * std::sqrt(bestDistanceSquared) + BVH_TIE_DISTANCE * BVH_TIE_DISTANCE;
+}
+
+bool TriangleBVH::Closest(const Vec3& p, float maxDistanceSquared, TriangleHit& hit) const
+{
+  if (nodes.empty() || BoxDistanceSquared(nodes[0], p) > maxDistanceSquared) return false;
+
+  float best      = maxDistanceSquared;
+  float slack     = TieSlack(best);
+  float bestPlane = -1.0f;   // |(p - q) . n| of the current best
+  int   bestTriangle = -1;
+  Vec3  bestPoint{0.0f, 0.0f, 0.0f};
+
+  int stack[BVH_MAX_DEPTH];
+  int top   = 0;
+  int index = 0;
+  for (;;) {
+    const BVHNode& node = nodes[index];
+    if (node.count > 0) {
+      for (int t = node.first; t < node.first + node.count; ++t) {
+        const Vec3* tri = &vertices[3 * t];
+        Vec3 q = ClosestPtPointTriangle(p, tri[0], tri[1], tri[2]);
+        Vec3 diff = p - q;
+        float d2 = diff.Dot(diff);
+        if (d2 > best + slack) continue;
+        float plane = std::fabs(diff.Dot(normals[t]));
+        if (d2 < best - slack || plane > bestPlane) {
+          if (d2 < best) {
+            best  = d2;
+            slack = TieSlack(best);
+          }
+          bestPlane    = plane;
+          bestTriangle = t;
+          bestPoint    = q;
+        }
+      }
+    } else {
+      // nearer child first; the farther one waits on the stack
+      int near = node.first, far = node.first + 1;
+      float nearDistance = BoxDistanceSquared(nodes[near], p);
+      float farDistance  = BoxDistanceSquared(nodes[far], p);
+      if (farDistance < nearDistance) {
+        std::swap(near, far);
+        std::swap(nearDistance, farDistance);
+      }
+      if (nearDistance <= best + slack) {
+        if (farDistance <= best + slack) stack[top++] = far;
+        index = near;
+        continue;
+      }
+    }
+
+    // pop, dropping boxes the best so far has moved out of reach
+    for (;;) {
+      if (top == 0) {
+        if (bestTriangle < 0) return false;
+        hit.point           = bestPoint;
+        hit.normal          = normals[bestTriangle];
+        hit.distanceSquared = best;
+        return true;
+      }
+      index = stack[--top];
+      if (BoxDistanceSquared(nodes[index], p) <= best + slack) break;
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include "../linear_algebra.h"
+
+constexpr int   BVH_LEAF_TRIANGLES = 4;     // a node with this many triangles or fewer is never split
+constexpr int   BVH_SAH_BINS       = 12;    // centroid bins per axis when evaluating splits
+constexpr int   BVH_MAX_DEPTH      = 64;    // traversal stack size
+constexpr float BVH_TIE_DISTANCE   = 1e-6f; // closest points this close count as the same feature
+
+// Leaves (count > 0) own triangles [first, first + count); interior nodes
+// keep their two children next to each other at first and first + 1.
+struct BVHNode {
+  Vec3 boundsMin;
+  int  first;
+  Vec3 boundsMax;
+  int  count;
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode should fill half a cache line");
+
+struct TriangleHit {
+  Vec3  point;            // closest point on the mesh
+  Vec3  normal;           // outward face normal of the triangle it lies on
+  float distanceSquared;
+};
+
+// Flattened SAH bounding volume hierarchy over a closed triangle mesh. Sibling
+// nodes are allocated as a pair, so a traversal step reads both child boxes
+// from 64 contiguous bytes.
+// Triangles are stored reordered by leaf with their outward normals; the
+// orientation is taken from the mesh's signed volume, so either winding works.
+class TriangleBVH {
+public:
+  // triangles holds count vertices, three per triangle, as in TriCollider
+  void Build(const Vec3* triangles, size_t count);
+
+  // Closest point on the mesh to p nearer than sqrt(maxDistanceSquared);
+  // false when there is none. Where several triangles share the closest
+  // point (an edge or vertex), the one whose plane is furthest from p is
+  // reported, so the sign of (p - point) . normal is still correct.
+  bool Closest(const Vec3& p, float maxDistanceSquared, TriangleHit& hit) const;
+
+  // A point outside the root box cannot be inside the mesh
+  bool BoundsContain(const Vec3& p) const {
+    const BVHNode& root = nodes[0];
+    return p.x >= root.boundsMin.x && p.y >= root.boundsMin.y && p.z >= root.boundsMin.z &&
+           p.x <= root.boundsMax.x && p.y <= root.boundsMax.y && p.z <= root.boundsMax.z;
+  }
+
+  bool   Empty() const { return normals.empty(); }
+  size_t NodeCount() const { return nodes.size(); }
+  size_t Bytes() const {
+    return nodes.size() * sizeof(BVHNode) + vertices.size() * sizeof(Vec3) +
+           normals.size() * sizeof(Vec3);
+  }
+
+private:
+  void Subdivide(int node, std::vector<int>& order, const std::vector<Vec3>& centroids,
+                 const Vec3* triangles, int depth);
+
+  std::vector<BVHNode> nodes;
+  std::vector<Vec3>    vertices;  // three per triangle, in leaf order
+  std::vector<Vec3>    normals;   // one per triangle
+};
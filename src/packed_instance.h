@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include "linear_algebra.h"
+
+constexpr float INSTANCE_MAX_SPEED = 3.0f;   // speed drawn in the top colour
+
+// One particle as the renderer draws it: 8 bytes instead of two Vec3. The
+// position is 16-bit fixed point over the [-1, 1] domain and only the speed
+// of the velocity is kept, over [0, INSTANCE_MAX_SPEED]; both are read as
+// normalized unsigned shorts and decoded in vertex.glsl.
+struct PackedInstance {
+  uint16_t x, y, z, speed;
+};
+static_assert(sizeof(PackedInstance) == 8, "read as one normalized ushort4 attribute");
+
+// The instances of one spatial grid cell, a run in grid order. lo and hi
+// bound the positions as quantised (their speed is unused) so the renderer
+// can cull the run as a box; splat is the cell's mean position and speed,
+// drawn in its place when the cell is far away.
+struct InstanceCell {
+  int first = 0, count = 0;
+  PackedInstance lo{}, hi{}, splat{};
+};
+
+DEVICE_CALLABLE
+inline uint16_t QuantiseUnit(float t)
+{
+  // written so NaN lands on 0, like the SIMD Max/Min in PackKernel
+  t = t > 0.0f ? t : 0.0f;
+  t = t < 1.0f ? t : 1.0f;
+  return (uint16_t)(t * 65535.0f + 0.5f);
+}
+
+DEVICE_CALLABLE
+inline PackedInstance PackInstance(const Vec3& position, const Vec3& velocity)
+{
+  const float speed = SQRT(velocity.x * velocity.x + velocity.y * velocity.y +
+                           velocity.z * velocity.z);
+  return PackedInstance{QuantiseUnit((position.x + 1.0f) * 0.5f),
+                        QuantiseUnit((position.y + 1.0f) * 0.5f),
+                        QuantiseUnit((position.z + 1.0f) * 0.5f),
+                        QuantiseUnit(speed * (1.0f / INSTANCE_MAX_SPEED))};
+}
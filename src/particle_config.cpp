@@ -21,9 +21,34 @@ float initOffsetX      =  0.0f;
 float initOffsetY      = 0.0f;
 float initOffsetZ      = 0.0f;
 float radiusLogical    =  7.0f;
+bool  persistentInstances = true;
+ParticleSprite particleSprite = ParticleSprite::POLYGON;
+bool  cullParticleCells   = true;
+float particleLodDistance = 5.0f;
 
 float energyRetention = 0.7f;
 
+bool  verletLists          = true;
+bool  skinAutoTune         = true;
+float skinFraction         = 0.3f;
+ParallelBackend parallelBackend = ParallelBackend::POOL;
+int   poolThreads          = 0;
+int   parallelGrain        = 256;
+bool  pinThreads           = false;
+SDFGradient sdfGradientMode = SDFGradient::ANALYTIC;
+int   sdfVolumeResolution  = 64;
+const char* meshColliderPath = "meshes/SChannel.obj";
+int   meshSDFResolution    = 96;
+bool  bucketedColliders    = false;
+bool  collisionCache       = true;
+CollisionSchedule collisionSchedule = CollisionSchedule::EVERY_ITERATION;
+bool  threadedSim          = true;
+bool  jacobiSolver         = false;
+KernelFamily kernelFamily  = KernelFamily::AUTO;
+bool  usePairCache         = false;
+int   reorderInterval      = 200;
+float reorderDegradeFactor = 2.0f;
+
 #ifdef USE_CUDA
 unsigned int numParticles = 500'000;
 float initSpacing = 0.013f;
@@ -1,5 +1,6 @@
 #pragma once
 #include "linear_algebra.h"
+#include "solver_kernels.h"
 // mouse interaction
 extern float pushStrength;
 extern float pullStrength;
@@ -13,11 +14,55 @@ extern float initOffsetY;         // vertical offset amount in NDC units (negati
 extern float initOffsetZ;
 
 extern float radiusLogical;        // size of particle to be drawn on screen in pixels
+extern bool  persistentInstances;  // particle instance ring mapped once when the driver has glBufferStorage, else mapped per frame
+// Particle sprite: the full quad with the disc cut out by discard, or a
+// polygon inscribed in the disc that needs no discard and keeps early depth testing
+enum class ParticleSprite { QUAD, POLYGON };
+extern ParticleSprite particleSprite;
+extern bool  cullParticleCells;    // upload and draw only the spatial grid cells inside the view frustum
+extern float particleLodDistance;  // grid cells farther than this from the camera drawn as one splat each (0 = off)
 extern unsigned int numParticles; // number of particles in simulation
 
 // spatial hashing settings
 extern float smoothingRadius;       // defines the area of influence of particle (Increase: slower simulation, greater instability, more accuracy)
-const constexpr int MAX_NEIGHBOURS = 256; // size of data structure to hold neighbouring particles (Too small: simulation will explode. Too big: large memory consumption, slower iteration)
+const constexpr int MAX_NEIGHBOURS = 256; // per-particle neighbour slots on the GPU (Too small: simulation will explode. Too big: large memory consumption, slower iteration). The CPU path uses unbounded CSR lists
+const constexpr int GRID_CHUNK_PARTICLES = 8192; // minimum particles per grid-build chunk (each chunk owns a full cell histogram)
+const constexpr int SCAN_BLOCK_ELEMENTS  = 4096; // minimum elements per block in the parallel prefix sum
+extern bool  verletLists;          // build neighbour lists out to h + skin and reuse them until a particle moves skin / 2
+extern bool  skinAutoTune;         // adapt the Verlet skin at runtime to minimise rebuild + padded pair cost
+extern float skinFraction;         // initial Verlet skin as a fraction of h
+const constexpr int   SKIN_TUNE_WINDOW  = 60;    // frames per skin tuning measurement
+const constexpr float SKIN_MIN_FRACTION = 0.05f; // skin bounds as a fraction of h
+const constexpr float SKIN_MAX_FRACTION = 1.0f;
+// CPU parallel backends; TBB or std::execution depending on the build
+enum class ParallelBackend { POOL, TBB, STD };
+extern ParallelBackend parallelBackend;
+extern int   poolThreads;          // thread pool size including the calling thread (0 = all hardware threads)
+extern int   parallelGrain;        // particles per work chunk (smaller: better balance, more scheduling overhead)
+extern bool  pinThreads;           // pin pool workers to cores
+const constexpr int STD_MAX_CHUNKS = 256; // chunks per std::execution loop
+// Collider normals when no baked volume is used: analytic derivatives through
+// the CSG, or central differences (the reference, six extra evaluations)
+enum class SDFGradient { ANALYTIC, FINITE_DIFFERENCE };
+extern SDFGradient sdfGradientMode;
+extern int   sdfVolumeResolution;  // baked SDF nodes along a shape's longest axis (0 = analytic SDF)
+extern const char* meshColliderPath; // OBJ baked into the MESH collider type
+extern int   meshSDFResolution;    // MESH volume nodes along the mesh's longest axis (always baked, no analytic form)
+// Where the collision pass runs: after every solver iteration, after the
+// last one only, or once per step on the final positions and velocities
+enum class CollisionSchedule { EVERY_ITERATION, LAST_ITERATION, END_OF_STEP };
+extern CollisionSchedule collisionSchedule;
+extern bool  collisionCache;       // per-particle distance bounds let particles far from every collider skip the SDF collision pass
+extern bool  bucketedColliders;    // CPU SDF collisions in particle packets against colliders grouped by type, instead of per particle through the broadphase
+extern bool  threadedSim;          // interactive app: solver on its own thread (ignored with CUDA)
+const constexpr float SIM_MIN_DT = 1.0f / 240.0f; // shortest wall-clock step of the sim thread
+extern bool  jacobiSolver;         // passes read one buffer and write another: bit-identical for any thread count (disables skin auto-tuning)
+const constexpr unsigned TRICKLER_SEED = 12345; // trickler jitter seed in Jacobi mode
+extern KernelFamily kernelFamily;  // SIMD family for the CPU neighbour loops (AUTO = widest the CPU supports)
+const constexpr int SOA_PADDING = 16;   // SoA columns are padded to a multiple of the widest vector (AVX-512 floats)
+extern bool  usePairCache;         // cache per-pair diff / W / gradient terms once per position update instead of recomputing them in every pass
+extern int   reorderInterval;      // frames between Morton reorders of the particle arrays (0 = only when locality degrades)
+extern float reorderDegradeFactor; // reorder early once neighbour index spread grows by this factor (0 = never)
 
 // particle behaviour
 extern float relaxation;
@@ -1,4 +1,11 @@
 #include "particle_mesh.h"
+#include "particle_config.h"
+#ifdef USE_CUDA
+#include "particles.cuh"
+#endif
+
+#include <cmath>
+#include <cstring>
 
 ParticleMesh::ParticleMesh() {
     std::vector<float> positions = {
@@ -13,6 +20,16 @@ ParticleMesh::ParticleMesh() {
     };
     vertexCount = 6;
 
+    // polygon sprite after the quad: a fan inscribed in the shaded disc,
+    // which fragment.glsl puts at half the quad's extent
+    for (int k = 0; k < PARTICLE_SPRITE_SIDES; ++k) {
+        float a = 2.0f * PI * k / PARTICLE_SPRITE_SIDES;
+        positions.insert(positions.end(), {0.5f * std::cos(a), 0.5f * std::sin(a), 0.0f});
+    }
+    for (int k = 1; k + 1 < PARTICLE_SPRITE_SIDES; ++k)
+        elementIndices.insert(elementIndices.end(), {4u, 4u + k, 4u + k + 1});
+    polygonIndexCount = 3 * (PARTICLE_SPRITE_SIDES - 2);
+
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
 
@@ -33,82 +50,81 @@ ParticleMesh::ParticleMesh() {
     glBindVertexArray(0);
 }
 
-void ParticleMesh::SetupInstanceBuffers(int num_particles){
+void ParticleMesh::BindInstances(size_t offset){
     glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instances.Buffer());
 
-    // instance positions
-    glGenBuffers(1, &instancePosVBO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, instancePosVBO);
-    glBufferData(GL_ARRAY_BUFFER, num_particles * sizeof(Vec3), nullptr,
-                 GL_DYNAMIC_DRAW);
-
-#ifdef USE_CUDA
-    HANDLE_ERROR(cudaGraphicsGLRegisterBuffer(
-        &positionsCudaResource, instancePosVBO, cudaGraphicsRegisterFlagsNone));
-
-#endif
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), (void*)0);
+    // instance position and speed, normalized to [0, 1] on fetch
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedInstance), (void*)offset);
     glEnableVertexAttribArray(1);
-    glVertexAttribDivisor(1,1);
-
-    // instance velocities
-    glGenBuffers(1, &instanceVelVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVelVBO);
-    glBufferData(GL_ARRAY_BUFFER, num_particles * sizeof(Vec3), nullptr,
-                 GL_DYNAMIC_DRAW);
-#ifdef USE_CUDA
-    HANDLE_ERROR(cudaGraphicsGLRegisterBuffer(&velocitiesCudaResource,
-                                              instanceVelVBO,
-                                              cudaGraphicsRegisterFlagsNone));
-#endif
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), (void*)0);
-    glEnableVertexAttribArray(2);
-    glVertexAttribDivisor(2, 1);
+    glVertexAttribDivisor(1, 1);
 }
 
-void ParticleMesh::UpdateInstanceData(const std::vector<Vec3>& positions, const std::vector<Vec3>& velocities){
-    glBindBuffer(GL_ARRAY_BUFFER, instancePosVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(Vec3), positions.data());
+PackedInstance* ParticleMesh::BeginInstances(int count){
+    const size_t bytes = count * sizeof(PackedInstance);
+    uploadBytes   = 0;
+    regionWritten = false;
+    if (count <= 0) return nullptr;
+    instances.Reserve(bytes, persistentInstances);
+    regionOffset = instances.Acquire();
+    // written in place by the caller, no driver-side staging
+    return (PackedInstance*)instances.Map(bytes);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVelVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, velocities.size() * sizeof(Vec3), velocities.data());
+void ParticleMesh::EndInstances(int written){
+    instances.Unmap();
+    uploadBytes   = written * sizeof(PackedInstance);
+    regionWritten = written > 0;
 }
 
 #ifdef USE_CUDA
 void ParticleMesh::gpuUpdateInstanceData(Vec3 *positions_d, Vec3 *velocities_d,
                                          int numParticles) {
-  HANDLE_ERROR(cudaGraphicsMapResources(1, &positionsCudaResource, 0));
-  HANDLE_ERROR(cudaGraphicsMapResources(1, &velocitiesCudaResource, 0));
-  
-  Vec3* mappedPos;
-  Vec3* mappedVel;
+  const size_t bytes = numParticles * sizeof(PackedInstance);
+  uploadBytes   = 0;
+  regionWritten = false;
+  if (numParticles <= 0) return;
+  // CUDA writes through interop, so the ring is never mapped on the CPU
+  if (instances.Reserve(bytes, false) || !instancesCudaResource) {
+    if (instancesCudaResource)
+      HANDLE_ERROR(cudaGraphicsUnregisterResource(instancesCudaResource));
+    HANDLE_ERROR(cudaGraphicsGLRegisterBuffer(&instancesCudaResource, instances.Buffer(),
+                                              cudaGraphicsRegisterFlagsWriteDiscard));
+  }
+  regionOffset = instances.Acquire();
+  HANDLE_ERROR(cudaGraphicsMapResources(1, &instancesCudaResource, 0));
+
+  char* mapped;
   size_t num_bytes;
-  HANDLE_ERROR(cudaGraphicsResourceGetMappedPointer((void**)&mappedPos, &num_bytes, positionsCudaResource));
-  HANDLE_ERROR(cudaGraphicsResourceGetMappedPointer((void**)&mappedVel, &num_bytes, velocitiesCudaResource));
+  HANDLE_ERROR(cudaGraphicsResourceGetMappedPointer((void**)&mapped, &num_bytes, instancesCudaResource));
 
-  HANDLE_ERROR(cudaMemcpy(mappedPos, positions_d, numParticles * sizeof(Vec3), cudaMemcpyDeviceToDevice));
-  HANDLE_ERROR(cudaMemcpy(mappedVel, velocities_d, numParticles * sizeof(Vec3), cudaMemcpyDeviceToDevice));
+  gpuPackInstances(positions_d, velocities_d, (PackedInstance*)(mapped + regionOffset), numParticles);
 
-  HANDLE_ERROR(cudaGraphicsUnmapResources(1, &positionsCudaResource, 0));
-  HANDLE_ERROR(cudaGraphicsUnmapResources(1, &velocitiesCudaResource, 0));
-  HANDLE_ERROR(cudaDeviceSynchronize()); 
+  HANDLE_ERROR(cudaGraphicsUnmapResources(1, &instancesCudaResource, 0));
+  uploadBytes   = bytes;
+  regionWritten = true;
 }
 #endif
 
-void ParticleMesh::DrawInstanced(int num_particles) {
-    glBindVertexArray(VAO);
-    glDrawElementsInstanced(GL_TRIANGLES, vertexCount, GL_UNSIGNED_INT, 0, num_particles);
+void ParticleMesh::DrawInstanced(int first, int count) {
+    if (count <= 0 || !regionWritten) return;
+    // GL 3.3 has no base instance, so the attribute moves instead
+    BindInstances(regionOffset + first * sizeof(PackedInstance));
+    if (particleSprite == ParticleSprite::POLYGON)
+        glDrawElementsInstanced(GL_TRIANGLES, polygonIndexCount, GL_UNSIGNED_INT,
+                                (void*)(vertexCount * sizeof(unsigned int)), count);
+    else
+        glDrawElementsInstanced(GL_TRIANGLES, vertexCount, GL_UNSIGNED_INT, 0, count);
+    // the region stays reserved until the last draw from it has run
+    instances.Fence();
 }
 
 ParticleMesh::~ParticleMesh() {
 #ifdef USE_CUDA
-  HANDLE_ERROR(cudaGraphicsUnregisterResource(positionsCudaResource));
-  HANDLE_ERROR(cudaGraphicsUnregisterResource(velocitiesCudaResource));
+  if (instancesCudaResource)
+    HANDLE_ERROR(cudaGraphicsUnregisterResource(instancesCudaResource));
 #endif
   glDeleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
   glDeleteBuffers(1, &EBO);
-  glDeleteBuffers(1, &instancePosVBO);
-  glDeleteBuffers(1, &instanceVelVBO);
 }
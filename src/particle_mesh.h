@@ -2,6 +2,9 @@
 #include <vector>
 #include <glad/glad.h>
 #include "linear_algebra.h"
+#include "instance_ring.h"
+#include "packed_instance.h"
+#include "pass_query.h"
 
 #ifdef USE_CUDA
 #include "cuda_runtime_api.h"
@@ -11,25 +14,46 @@
 
 #endif
 
+constexpr int PARTICLE_SPRITE_SIDES = 12;   // polygon sprite, ParticleSprite::POLYGON
+
 class ParticleMesh {
 public:
   ParticleMesh();
   ~ParticleMesh();
-  void SetupInstanceBuffers(int num_particles);
-  void UpdateInstanceData(const std::vector<Vec3> &positions,
-                          const std::vector<Vec3> &velocities);
+  // Moves to the next ring region and maps room for count instances; the
+  // ring grows to fit, so it follows ResizeParticles without a setup call.
+  // nullptr when there is nothing to map.
+  PackedInstance* BeginInstances(int count);
+  // Unmaps; the first written instances are what the draws below read
+  void EndInstances(int written);
 #ifdef USE_CUDA
+  // Packs straight from the device arrays into the ring
   void gpuUpdateInstanceData(Vec3 *positions_d, Vec3 *velocities_d,
                              int numParticles);
 #endif
-  void DrawInstanced(int num_particles);
-    
+  // Instances [first, first + count) of the current region, as the
+  // particleSprite geometry
+  void DrawInstanced(int first, int count);
+
+  size_t UploadBytes() const { return uploadBytes; }
+  const InstanceRing& Instances() const { return instances; }
+  // GPU cost of the particle draws, around them in Render
+  PassQuery& Pass() { return pass; }
 
 private:
+  // Points the instance attribute at the PackedInstance array at offset in
+  // the ring
+  void BindInstances(size_t offset);
+
   unsigned int VAO, VBO, EBO;
-  GLuint instancePosVBO, instanceVelVBO;
+  InstanceRing instances;
+  PassQuery    pass;
+  size_t regionOffset  = 0;      // of the current region in the ring
+  size_t uploadBytes   = 0;      // last update
+  bool   regionWritten = false;  // current region holds this frame's instances
 #ifdef USE_CUDA
-  cudaGraphicsResource *velocitiesCudaResource, *positionsCudaResource;
+  cudaGraphicsResource *instancesCudaResource = nullptr;
 #endif
-  int vertexCount;
+  int vertexCount;         // quad indices
+  int polygonIndexCount;   // polygon indices, after the quad's
 };
@@ -1,11 +1,13 @@
 #include "particles.h"
 #include "particle_config.h"
+#include "objects3d/sdf_volume.h"
 
 #ifdef USE_CUDA
 #include "cuda_buffers.cuh"
 #include "particles.cuh"
 #endif
 
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <algorithm>
@@ -17,6 +19,14 @@ auto us = [](auto a, auto b) {
   return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
  };
 
+// Adds the wall time of its scope to total, used by the Verlet skin tuner
+struct CostTimer {
+  double&          total;
+  bool             active;
+  clk::time_point  start = clk::now();
+  ~CostTimer() { if (active) total += us(start, clk::now()) / 1000.0; }
+};
+
 Particles::Particles(int n, float smoothingRadius)
   : h2(smoothingRadius * smoothingRadius)
   , h5(h2 * h2 * smoothingRadius)
@@ -27,7 +37,7 @@ Particles::Particles(int n, float smoothingRadius)
   float dq  = 0.14f * smoothingRadius;
   float sq  = h2 - dq * dq;
   wDq      = poly6 * sq * sq * sq;
-  skinRadius = 0.3f * smoothingRadius;
+  skinRadius = skinFraction * smoothingRadius;
 
   numParticles    = n;
   activeParticles = n;
@@ -37,8 +47,7 @@ Particles::Particles(int n, float smoothingRadius)
   gridData.reserve(numParticles * 4);
   gridStart.resize(numCells + 1, 0);
   gridCount.resize(numCells, 0);
-  indices.resize(numParticles);
-  std::iota(indices.begin(), indices.end(), 0);
+  particleCell.resize(numParticles);
 
   positions.reserve(numParticles);
   predictedPositions.reserve(numParticles);
@@ -51,13 +60,15 @@ Particles::Particles(int n, float smoothingRadius)
   // Vorticity is a 3-D vector field (curl of velocity)
   vorticity.resize(numParticles, Vec3{0.0f, 0.0f, 0.0f});
 
-  neighbourData.resize(numParticles * MAX_NEIGHBOURS);
   neighbourCount.resize(numParticles, 0);
+  neighbourStart.resize(numParticles + 1, 0);
 
   InitialiseParticles(numParticles, initSpacing);
+  BuildMortonCellOrder();
   BuildGrid(smoothingRadius);
   BuildNeighbours(smoothingRadius);
-  positionsAtLastBuild = predictedPositions;
+  framesSinceReorder = 0;
+  spreadAtReorder = NeighbourIndexSpread();
 
 #ifdef USE_CUDA
   restDensity;
@@ -95,61 +106,357 @@ void Particles::InitialiseParticles(int n, float spacing)
 
 
 
-void Particles::BuildGrid(float smoothingRadius)
+int Particles::GridChunkCount() const
 {
-  const int numCells = numCells1D * numCells1D * numCells1D;
-  std::fill(gridCount.begin(), gridCount.end(), 0);
+  if (!runParallel) return 1;
+  int threads = ParallelThreadCount();
+  return std::max(1, std::min(threads, activeParticles / GRID_CHUNK_PARTICLES));
+}
 
-  // pass 1: count
-  for (int i = 0; i < activeParticles; ++i) {
-    Cell c = PositionToCoord(predictedPositions[i], smoothingRadius, numCells1D);
-    ++gridCount[CellIndex(c.x, c.y, c.z, numCells1D)];
+// Parallel exclusive prefix sum, offsets[0..n] from counts[0..n-1]
+void Particles::ExclusiveScan(const int* counts, int* offsets, int n)
+{
+  int numBlocks = 1;
+  if (runParallel) {
+    int threads = ParallelThreadCount();
+    numBlocks = std::max(1, std::min(threads, n / SCAN_BLOCK_ELEMENTS));
   }
+  const int perBlock = (n + numBlocks - 1) / numBlocks;
+  if ((int)scanBlockSum.size() < numBlocks)
+    scanBlockSum.resize(numBlocks);
+
+  ParallelFor(numBlocks, [&](int b) {
+    int end = std::min(n, (b + 1) * perBlock);
+    int sum = 0;
+    for (int i = b * perBlock; i < end; ++i)
+      sum += counts[i];
+    scanBlockSum[b] = sum;
+  });
 
-  gridStart[0] = 0;
-  for (int c = 0; c < numCells; ++c)
-    gridStart[c + 1] = gridStart[c] + gridCount[c];
+  int running = 0;
+  for (int b = 0; b < numBlocks; ++b) {
+    int blockSum = scanBlockSum[b];
+    scanBlockSum[b] = running;
+    running += blockSum;
+  }
 
-  // pass 2: fill
+  offsets[0] = 0;
+  ParallelFor(numBlocks, [&](int b) {
+    int end = std::min(n, (b + 1) * perBlock);
+    int start = scanBlockSum[b];
+    for (int i = b * perBlock; i < end; ++i) {
+      start += counts[i];
+      offsets[i + 1] = start;
+    }
+  });
+}
+
+// Parallel counting sort. Each chunk histograms a contiguous slice of
+// particles, the histograms are turned into per-chunk write offsets, and the
+// scatter preserves index order within a cell, so the layout matches the
+// serial two-pass build exactly.
+void Particles::BuildGrid(float smoothingRadius)
+{
+  const int numCells  = numCells1D * numCells1D * numCells1D;
+  const int numChunks = GridChunkCount();
+  const int chunkSize = (activeParticles + numChunks - 1) / numChunks;
+
+  if ((int)particleCell.size() < activeParticles)
+    particleCell.resize(numParticles);
+  if ((int)chunkCellCount.size() < numChunks * numCells)
+    chunkCellCount.resize(numChunks * numCells);
+
+  // pass 1: per-chunk histograms
+  ParallelFor(numChunks, [&](int c) {
+    int* counts = &chunkCellCount[c * numCells];
+    std::fill(counts, counts + numCells, 0);
+    int end = std::min(activeParticles, (c + 1) * chunkSize);
+    for (int i = c * chunkSize; i < end; ++i) {
+      Cell cell = PositionToCoord(predictedPositions[i], smoothingRadius, numCells1D);
+      int idx = CellIndex(cell.x, cell.y, cell.z, numCells1D);
+      particleCell[i] = idx;
+      ++counts[idx];
+    }
+  });
+
+  // pass 2: per-cell totals, histograms become chunk offsets within the cell
+  const int cellsPerBlock = (numCells + numChunks - 1) / numChunks;
+  ParallelFor(numChunks, [&](int b) {
+    int end = std::min(numCells, (b + 1) * cellsPerBlock);
+    for (int cell = b * cellsPerBlock; cell < end; ++cell) {
+      int running = 0;
+      for (int c = 0; c < numChunks; ++c) {
+        int count = chunkCellCount[c * numCells + cell];
+        chunkCellCount[c * numCells + cell] = running;
+        running += count;
+      }
+      gridCount[cell] = running;
+    }
+  });
+
+  // pass 3: exclusive prefix sum over gridCount
+  ExclusiveScan(gridCount.data(), gridStart.data(), numCells);
+
+  // pass 4: scatter
   gridData.resize(gridStart[numCells]);
-  std::vector<int> insertPos(gridStart.begin(), gridStart.begin() + numCells);
+  ParallelFor(numChunks, [&](int c) {
+    int* offsets = &chunkCellCount[c * numCells];
+    int end = std::min(activeParticles, (c + 1) * chunkSize);
+    for (int i = c * chunkSize; i < end; ++i) {
+      int idx = particleCell[i];
+      gridData[gridStart[idx] + offsets[idx]++] = i;
+    }
+  });
+}
+
+// ---------------------------------------------------------------------------
+// Visits every particle in the cells that can hold a point within radius of
+// particle i. Cells are smoothingRadius wide, so radius <= h is the usual 27
+// cell stencil; a Verlet skin widens it to 5x5x5 and the corner cells that lie
+// entirely outside the radius are skipped.
+template<typename F>
+void Particles::ForEachCandidate(int i, float smoothingRadius, float radius, F&& func)
+{
+  const Vec3 p = predictedPositions[i];
+  Cell cell = PositionToCoord(p, smoothingRadius, numCells1D);
+  const int reach = std::max(1, (int)std::ceil(radius / smoothingRadius - 1e-4f));
+  const float r2 = radius * radius;
+
+  // distance from p to the slab of cells c along one axis
+  auto gap = [&](float x, int c, int o) {
+    if (o == 0) return 0.0f;
+    float lo = -1.0f + c * smoothingRadius;
+    return o > 0 ? std::max(0.0f, lo - x) : std::max(0.0f, x - (lo + smoothingRadius));
+  };
+
+  for (int ox = -reach; ox <= reach; ++ox) {
+    int cx = cell.x + ox;
+    if (cx < 0 || cx >= numCells1D) continue;
+    float gx = gap(p.x, cx, ox);
+    for (int oy = -reach; oy <= reach; ++oy) {
+      int cy = cell.y + oy;
+      if (cy < 0 || cy >= numCells1D) continue;
+      float gy = gap(p.y, cy, oy);
+      for (int oz = -reach; oz <= reach; ++oz) {
+        int cz = cell.z + oz;
+        if (cz < 0 || cz >= numCells1D) continue;
+        if (reach > 1) {
+          float gz = gap(p.z, cz, oz);
+          if (gx * gx + gy * gy + gz * gz > r2) continue;
+        }
 
-  for (int i = 0; i < activeParticles; ++i) {
-    Cell c = PositionToCoord(predictedPositions[i], smoothingRadius, numCells1D);
-    int idx = CellIndex(c.x, c.y, c.z, numCells1D);
-    gridData[insertPos[idx]++] = i;
+        int idx = CellIndex(cx, cy, cz, numCells1D);
+        for (int k = gridStart[idx]; k < gridStart[idx + 1]; ++k)
+          func(gridData[k]);
+      }
+    }
   }
 }
 
-// ---------------------------------------------------------------------------
+// Lists are built out to h + skin in Verlet mode so they stay valid until some
+// particle has moved half the skin; otherwise they hold exactly the pairs
+// within h and are rebuilt every frame.
+float Particles::NeighbourListRadius(float smoothingRadius) const
+{
+  return verletLists ? smoothingRadius + skinRadius : smoothingRadius;
+}
+
+// CSR build: count, prefix sum into neighbourStart, then fill. Lists are
+// exactly as long as they need to be, so nothing is ever truncated.
 void Particles::BuildNeighbours(float smoothingRadius)
 {
+  const float radius = NeighbourListRadius(smoothingRadius);
+  const float r2     = radius * radius;
+
   ParallelFor(activeParticles, [&](int i) {
+    const Vec3 pi = predictedPositions[i];
     int count = 0;
-    int *myNeighbours = &neighbourData[i * MAX_NEIGHBOURS];
-    Cell cell = PositionToCoord(predictedPositions[i], smoothingRadius, numCells1D);
-
-    for (int ox = -1; ox <= 1; ++ox)
-      for (int oy = -1; oy <= 1; ++oy)
-        for (int oz = -1; oz <= 1; ++oz) {
-          int cx = cell.x + ox;
-          int cy = cell.y + oy;
-          int cz = cell.z + oz;
-          if (cx < 0 || cy < 0 || cz < 0 || cx >= numCells1D || cy >= numCells1D ||
-              cz >= numCells1D)
-            continue;
-
-          int idx = CellIndex(cx, cy, cz, numCells1D);
-          for (int k = gridStart[idx]; k < gridStart[idx + 1]; ++k) {
-            int j = gridData[k];
-            Vec3 diff = predictedPositions[j] - predictedPositions[i];
-            float d2 = diff.Dot(diff);
-            if (d2 <= h2 && count < MAX_NEIGHBOURS)
-              myNeighbours[count++] = j;
-          }
-        }
+    ForEachCandidate(i, smoothingRadius, radius, [&](int j) {
+      Vec3 diff = predictedPositions[j] - pi;
+      if (diff.Dot(diff) <= r2)
+        ++count;
+    });
     neighbourCount[i] = count;
   });
+  std::fill(neighbourCount.begin() + activeParticles, neighbourCount.end(), 0);
+
+  ExclusiveScan(neighbourCount.data(), neighbourStart.data(), numParticles);
+  neighbourData.resize(neighbourStart[numParticles]);
+
+  ParallelFor(activeParticles, [&](int i) {
+    const Vec3 pi = predictedPositions[i];
+    int* myNeighbours = &neighbourData[neighbourStart[i]];
+    int count = 0;
+    ForEachCandidate(i, smoothingRadius, radius, [&](int j) {
+      Vec3 diff = predictedPositions[j] - pi;
+      if (diff.Dot(diff) <= r2)
+        myNeighbours[count++] = j;
+    });
+  });
+
+  positionsAtLastBuild = predictedPositions;
+  activeAtLastBuild    = activeParticles;
+  builtSkin            = radius - smoothingRadius;
+  needsRebuild         = false;
+}
+
+// Per-entry kernel terms for the CSR lists: diff = p_i - p_j, W = poly6(d)
+// and gradS = (h - d)^2 / d, the spiky gradient without its constant. Pairs
+// outside h (Verlet skin padding) store zeros; coincident pairs keep W but
+// zero gradS, matching the recompute loops that skip them.
+void Particles::RefreshPairCache(float smoothingRadius)
+{
+  pairDiff.resize(neighbourData.size());
+  pairW.resize(neighbourData.size());
+  pairGradS.resize(neighbourData.size());
+
+  ParallelFor(activeParticles, [&](int i) {
+    const Vec3 pi = predictedPositions[i];
+    for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+      Vec3  diff = pi - predictedPositions[neighbourData[k]];
+      float d2   = diff.Dot(diff);
+      pairDiff[k] = diff;
+      if (d2 >= h2) {
+        pairW[k]     = 0.0f;
+        pairGradS[k] = 0.0f;
+        continue;
+      }
+      float sq = h2 - d2;
+      pairW[k] = poly6 * sq * sq * sq;
+      if (d2 < 1e-12f) {
+        pairGradS[k] = 0.0f;
+      } else {
+        float d = std::sqrt(d2);
+        pairGradS[k] = (smoothingRadius - d) * (smoothingRadius - d) / d;
+      }
+    }
+  });
+}
+
+// AoS -> SoA copies for the SIMD kernels. Columns are padded to SOA_PADDING
+// floats; the padding is never read since the kernels gather by index.
+static int PaddedColumnSize(int n)
+{
+  return (n + SOA_PADDING - 1) / SOA_PADDING * SOA_PADDING;
+}
+
+static void ResizeColumns(int padded, AlignedVector<float>& x,
+                          AlignedVector<float>& y, AlignedVector<float>& z)
+{
+  if ((int)x.size() == padded) return;
+  x.assign(padded, 0.0f);
+  y.assign(padded, 0.0f);
+  z.assign(padded, 0.0f);
+}
+
+void Particles::SyncPositionColumns()
+{
+  ResizeColumns(PaddedColumnSize(numParticles), posX, posY, posZ);
+  ParallelFor(activeParticles, [&](int i) {
+    posX[i] = predictedPositions[i].x;
+    posY[i] = predictedPositions[i].y;
+    posZ[i] = predictedPositions[i].z;
+  });
+}
+
+void Particles::SyncVelocityColumns()
+{
+  const int padded = PaddedColumnSize(numParticles);
+  ResizeColumns(padded, velX, velY, velZ);
+  if ((int)omegaMag.size() != padded)
+    omegaMag.assign(padded, 0.0f);
+  ParallelFor(activeParticles, [&](int i) {
+    velX[i] = velocities[i].x;
+    velY[i] = velocities[i].y;
+    velZ[i] = velocities[i].z;
+  });
+}
+
+SolverKernelConstants Particles::KernelConstants(float smoothingRadius) const
+{
+  SolverKernelConstants c;
+  c.h                = smoothingRadius;
+  c.h2               = h2;
+  c.poly6            = poly6;
+  c.spiky            = spiky;
+  c.wDq              = wDq;
+  c.scorrCoefficient = scorrCoefficient;
+  c.restDensity      = restDensity;
+  c.relaxation       = relaxation;
+  c.selfDensity      = poly6 * h2 * h2 * h2;
+  return c;
+}
+
+size_t Particles::PairCacheBytes() const
+{
+  return pairDiff.capacity() * sizeof(Vec3) +
+         (pairW.capacity() + pairGradS.capacity()) * sizeof(float);
+}
+
+size_t Particles::NeighbourMemoryBytes() const
+{
+  return neighbourData.capacity() * sizeof(int) +
+         neighbourStart.capacity() * sizeof(int) +
+         neighbourCount.capacity() * sizeof(int);
+}
+
+void Particles::PackInstances(PackedInstance* out, std::vector<InstanceCell>& cells)
+{
+  const int n = activeParticles;
+  const int numCells = numCells1D * numCells1D * numCells1D;
+  const float invMaxSpeed = 1.0f / INSTANCE_MAX_SPEED;
+  cells.clear();
+
+  // a command since the last step (resize, reset) can leave the grid
+  // describing other particles
+  if ((int)gridStart.size() != numCells + 1 || gridStart[numCells] != n) {
+    if (!solverKernels) {
+      ParallelFor(n, [&](int i) { out[i] = PackInstance(positions[i], velocities[i]); });
+      return;
+    }
+    constexpr int batch = 256;
+    const int numBatches = (n + batch - 1) / batch;
+    ParallelFor(numBatches, std::max(1, parallelGrain / batch), [&](int b) {
+      solverKernels->pack(&positions[0].x, &velocities[0].x, nullptr, b * batch,
+                          std::min(n, (b + 1) * batch), invMaxSpeed, &out[0].x);
+    });
+    return;
+  }
+
+  for (int c = 0; c < numCells; ++c)
+    if (gridStart[c + 1] > gridStart[c])
+      cells.push_back(InstanceCell{gridStart[c], gridStart[c + 1] - gridStart[c]});
+
+  // a cell holds a handful of particles; its box and mean come from the
+  // run just written, still in cache
+  const int cellsPerChunk = std::max(1, parallelGrain * (int)cells.size() / std::max(1, n));
+  ParallelFor((int)cells.size(), cellsPerChunk, [&](int c) {
+    InstanceCell& cell = cells[c];
+    const int end = cell.first + cell.count;
+    if (solverKernels) {
+      solverKernels->pack(&positions[0].x, &velocities[0].x, gridData.data(), cell.first, end,
+                          invMaxSpeed, &out[0].x);
+    } else {
+      for (int k = cell.first; k < end; ++k)
+        out[k] = PackInstance(positions[gridData[k]], velocities[gridData[k]]);
+    }
+
+    PackedInstance lo = out[cell.first], hi = lo;
+    uint32_t sum[4] = {};
+    for (int k = cell.first; k < end; ++k) {
+      const PackedInstance& q = out[k];
+      lo = PackedInstance{std::min(lo.x, q.x), std::min(lo.y, q.y), std::min(lo.z, q.z), 0};
+      hi = PackedInstance{std::max(hi.x, q.x), std::max(hi.y, q.y), std::max(hi.z, q.z), 0};
+      sum[0] += q.x;
+      sum[1] += q.y;
+      sum[2] += q.z;
+      sum[3] += q.speed;
+    }
+    cell.lo    = lo;
+    cell.hi    = hi;
+    cell.splat = PackedInstance{(uint16_t)(sum[0] / cell.count), (uint16_t)(sum[1] / cell.count),
+                                (uint16_t)(sum[2] / cell.count), (uint16_t)(sum[3] / cell.count)};
+  });
 }
 
 // ---------------------------------------------------------------------------
@@ -162,21 +469,27 @@ float Particles::CalculateLambda(size_t i, float smoothingRadius)
 
   const Vec3& pI = predictedPositions[i];
 
-  int* myNeighbours = &neighbourData[i * MAX_NEIGHBOURS];
-  for (int k = 0; k < neighbourCount[i]; ++k) {
-    int j = myNeighbours[k];
+  for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+    int j = neighbourData[k];
     if (j == (int)i) continue;
 
-    Vec3  diff = pI - predictedPositions[j];
-    float d2   = diff.Dot(diff);
-    if (d2 >= h2 || d2 < 1e-12f) continue;
+    Vec3 grad;
+    if (pairCacheActive) {
+      if (pairGradS[k] == 0.0f) continue;
+      density += pairW[k];
+      grad     = pairDiff[k] * (spiky * pairGradS[k] / restDensity);
+    } else {
+      Vec3  diff = pI - predictedPositions[j];
+      float d2   = diff.Dot(diff);
+      if (d2 >= h2 || d2 < 1e-12f) continue;
 
-    float sq = h2 - d2;
-    density += poly6 * sq * sq * sq;
+      float sq = h2 - d2;
+      density += poly6 * sq * sq * sq;
 
-    float d   = std::sqrt(d2);
-    float s   = spiky * (smoothingRadius - d) * (smoothingRadius - d);
-    Vec3  grad = diff * (s / (d * restDensity));
+      float d   = std::sqrt(d2);
+      float s   = spiky * (smoothingRadius - d) * (smoothingRadius - d);
+      grad      = diff * (s / (d * restDensity));
+    }
     gradI      += grad;
     denominator += grad.Dot(grad);
   }
@@ -189,7 +502,8 @@ float Particles::CalculateLambda(size_t i, float smoothingRadius)
 // ---------------------------------------------------------------------------
 void Particles::Update(float dt, float smoothingRadius, float radiusPx,
 		       const int g_fb_w, const int g_fb_h,
-		       Vec3 rayOrigin, Vec3 rayDir, float mouseStrength, SDFCollider* colliders, AppState* as)
+		       Vec3 rayOrigin, Vec3 rayDir, float mouseStrength, SDFCollider* colliders,
+		       int numColliders, AppState* as)
 {
   if (tricklerMode){
 #ifdef USE_CUDA
@@ -203,6 +517,44 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
   const float mouseRadius  = mouseStrength > 0.0f ? pushRadius : pullRadius;
   const float mouseRadius2 = mouseRadius * mouseRadius;
 
+#ifndef USE_CUDA
+  activeKernelFamily = ResolveKernelFamily(kernelFamily);
+  solverKernels      = GetSolverKernels(activeKernelFamily);
+  // the SIMD kernels recompute every pair, so they take precedence over
+  // the pair cache; every pass and metric below goes by pairCacheActive
+  pairCacheActive = usePairCache && !solverKernels;
+  const SolverKernelConstants kc = KernelConstants(smoothingRadius);
+  if (jacobiSolver) {
+    predictedBack.resize(predictedPositions.size());
+    velocitiesBack.resize(velocities.size());
+  }
+  // no-ops unless the resolution / colliders changed; must not run inside
+  // the collision pass
+  const bool volumesChanged = EnsureSDFVolumes(sdfVolumeResolution, colliders, numColliders);
+  const bool collidersChanged = colliderBroadphase.Update(colliders, numColliders);
+  colliderBuckets.Update(colliders, numColliders);
+  if (volumesChanged || colliderBroadphase.ChangedAll() || !collisionCache) {
+    std::fill(collisionBounds.begin(), collisionBounds.end(), CollisionBound{});
+  } else if (collidersChanged) {
+    // an edit only invalidates the bounds that reach one of its colliders
+    const auto& changed = colliderBroadphase.ChangedBounds();
+    ParallelFor((int)collisionBounds.size(), [&](int i) {
+      for (const ColliderSlotBounds& box : changed)
+        if (collisionBounds[i].Reaches(box.lo, box.hi)) {
+          collisionBounds[i] = CollisionBound{};
+          break;
+        }
+    });
+  }
+  collisionBounds.resize(std::max((int)collisionBounds.size(), activeParticles));
+  int collisionSkips = 0, collisionPasses = 0;
+#endif
+
+  // Skin tuning cost: neighbour build plus every loop that walks the lists
+  const bool tuneSkin   = verletLists && skinAutoTune && !jacobiSolver;
+  double     pairCostMs = 0.0;
+  bool       rebuilt    = false;
+
   // 1. apply gravity + mouse force, predict positions
   {
     Profiler::Timer timer(GRAVITY_PREDICT, currentFrame, isBenchmarking);
@@ -250,6 +602,13 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
     //std::cout << "BUILDGRID Execution time CPU: " << us(t0,t1) / 1000.0f << std::endl;
 #endif
   }
+#ifndef USE_CUDA
+  {
+    Profiler::Timer timer(REORDER, currentFrame, isBenchmarking);
+    if (NeedsReorder())
+      ReorderParticles();
+  }
+#endif
   {
     Profiler::Timer timer(BUILD_NEIGHBOURS, currentFrame, isBenchmarking);
 #ifdef USE_CUDA
@@ -257,13 +616,19 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
     gpuBuildNeighbours(cb, smoothingRadius, skinRadius * skinRadius, numCells1D,
                        activeParticles);
 #else
+    CostTimer cost{pairCostMs, tuneSkin};
     if (NeedsNeighbourRebuild()) {
       // auto t0 = clk::now();
       BuildNeighbours(smoothingRadius);
       // auto t1 = clk::now();
       // std::cout << "BUILD NEIGHBOURS Execution time CPU: " << us(t0,t1) / 1000.0f << " ms" << std::endl;
-      positionsAtLastBuild = predictedPositions;
+      rebuilt = true;
     }
+    Profiler::Record(NEIGHBOUR_BYTES, currentFrame, (double)NeighbourMemoryBytes(), isBenchmarking);
+    Profiler::Record(NEIGHBOUR_PAIRS, currentFrame, (double)neighbourStart[numParticles], isBenchmarking);
+    Profiler::Record(NEIGHBOUR_REBUILD, currentFrame, rebuilt ? 1.0 : 0.0, isBenchmarking);
+    if (pairCacheActive)
+      Profiler::Record(PAIR_CACHE_BYTES, currentFrame, (double)PairCacheBytes(), isBenchmarking);
 #endif
   }
 
@@ -281,67 +646,80 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
 
       gpuClampToBoundaries(cb, radiusPx, g_fb_w, g_fb_h, activeParticles);
 #else
-      //auto t0 = clk::now();
-      ParallelFor(activeParticles, [&](int i) {
-	allLambdas[i] = CalculateLambda(i, smoothingRadius);
-      });
-      //auto t1 = clk::now();
-      //std::cout << "CALCULATELAMBDAS Execution time CPU: " << us(t0,t1) / 1000.0f << std::endl;
-
-
-      ParallelFor(activeParticles, [&](int i) {
-	Vec3        sum = {0.0f, 0.0f, 0.0f};
-	const Vec3& pi  = predictedPositions[i];
-
-	int* myNeighbours = &neighbourData[i * MAX_NEIGHBOURS];
-	for (int k = 0; k < neighbourCount[i]; ++k) {
-	  int j = myNeighbours[k];
-	  if (j == i)
-            continue;
+      {
+        CostTimer cost{pairCostMs, tuneSkin};
+        if (pairCacheActive) {
+          Profiler::Timer timer(PAIR_CACHE, currentFrame, isBenchmarking);
+          RefreshPairCache(smoothingRadius);
+        }
+        if (solverKernels)
+          SyncPositionColumns();
+        //auto t0 = clk::now();
+        ParallelFor(activeParticles, [&](int i) {
+          allLambdas[i] = solverKernels
+            ? solverKernels->lambda(i, neighbourData.data(), neighbourStart[i],
+                                    neighbourStart[i + 1], PositionColumns(), kc)
+            : CalculateLambda(i, smoothingRadius);
+        });
+        //auto t1 = clk::now();
+        //std::cout << "CALCULATELAMBDAS Execution time CPU: " << us(t0,t1) / 1000.0f << std::endl;
 
-	  Vec3  diff = pi - predictedPositions[j];
-	  float d2   = diff.Dot(diff);
-	  if (d2 < 1e-12f || d2 >= h2)
-            continue;
 
-	  float d   = std::sqrt(d2);
-	  float s   = spiky * (smoothingRadius - d) * (smoothingRadius - d) / d;
-	  float corr       = Scorr(pi, predictedPositions[j], h2, poly6, wDq, scorrCoefficient);
-	  float lambdaSum  = allLambdas[i] + allLambdas[j] + corr;
-	  sum += diff * (s * lambdaSum);
-	}
-        deltas[i] = sum / restDensity;
-	predictedPositions[i] += deltas[i];
-      });
+        ParallelFor(activeParticles, [&](int i) {
+          Vec3        sum = {0.0f, 0.0f, 0.0f};
+          const Vec3& pi  = predictedPositions[i];
+
+          if (solverKernels) {
+            KernelVec d = solverKernels->delta(i, neighbourData.data(), neighbourStart[i],
+                                               neighbourStart[i + 1], PositionColumns(),
+                                               allLambdas.data(), kc);
+            sum = Vec3{d.x, d.y, d.z};
+          } else {
+            for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+              int j = neighbourData[k];
+              if (j == i)
+                continue;
+
+              Vec3  diff;
+              float s, corr;
+              if (pairCacheActive) {
+                if (pairGradS[k] == 0.0f)
+                  continue;
+                diff = pairDiff[k];
+                s    = spiky * pairGradS[k];
+                corr = ScorrFromW(pairW[k], wDq, scorrCoefficient);
+              } else {
+                diff     = pi - predictedPositions[j];
+                float d2 = diff.Dot(diff);
+                if (d2 < 1e-12f || d2 >= h2)
+                  continue;
+
+                float d = std::sqrt(d2);
+                s    = spiky * (smoothingRadius - d) * (smoothingRadius - d) / d;
+                corr = Scorr(pi, predictedPositions[j], h2, poly6, wDq, scorrCoefficient);
+              }
+              float lambdaSum  = allLambdas[i] + allLambdas[j] + corr;
+              sum += diff * (s * lambdaSum);
+            }
+          }
+          deltas[i] = sum / restDensity;
+          if (jacobiSolver)
+            predictedBack[i] = predictedPositions[i] + deltas[i];
+          else
+            predictedPositions[i] += deltas[i];
+        });
+        if (jacobiSolver)
+          SwapJacobiBuffers(predictedPositions, predictedBack);
+      }
 
       ParallelFor(activeParticles, [&](int i) {
         ClampToBoundaries(&predictedPositions[i], radiusPx, g_fb_w, g_fb_h);
       });
 #endif
 
-      if (!useTriangleCollisions) {
-        Profiler::Timer timer(COLLISION_SDF, currentFrame, isBenchmarking);
-#ifdef USE_CUDA
-	CudaBuffers& cb = *as->cudaBuffers;
-	gpuProjectParticleSDF(cb, activeParticles);
-#else
-        ParallelFor(activeParticles, [&](int i) {
-	  for (int j{}; j < MAX_OBJECTS; ++j)
-            ProjectParticleSDF(predictedPositions[i], velocities[i], colliders[j]);
-        });
-#endif
-      } else {
-        Profiler::Timer timer(COLLISION_TRI_BRUTE, currentFrame,
-                              isBenchmarking);
-#ifdef USE_CUDA
-        CudaBuffers &cb = *as->cudaBuffers;
-        gpuProjectParticleTri(cb, gClosestPoints.data(), activeParticles);
-#else
-        ParallelFor(activeParticles, [&](int i) {
-          for (const TriCollider &collider : gTriColliders)
-	    ProjectParticleTri(predictedPositions[i], velocities[i], collider, gClosestPoints[i]);
-        });
-#endif
+      if (CollideInIteration(iter)) {
+        collisionSkips += ProjectCollisions(predictedPositions.data(), velocities.data(), colliders, as);
+        ++collisionPasses;
       }
     }
   }
@@ -366,6 +744,19 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
 
   //std::vector<Vec3> newVelocities = velocities;
 
+  // XSPH and vorticity share one refresh at the final positions
+#ifndef USE_CUDA
+  if (pairCacheActive) {
+    Profiler::Timer timer(PAIR_CACHE, currentFrame, isBenchmarking);
+    CostTimer cost{pairCostMs, tuneSkin};
+    RefreshPairCache(smoothingRadius);
+  }
+  if (solverKernels) {
+    SyncPositionColumns();
+    SyncVelocityColumns();
+  }
+#endif
+
   // 5. XSPH viscosity
   {
     Profiler::Timer timer(VISCOSITY, currentFrame, isBenchmarking);
@@ -373,25 +764,39 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
     CudaBuffers& cb = *as->cudaBuffers;
     gpuViscosity(cb, velocities.data(), h2, xsphC, activeParticles);
 #else
+    CostTimer cost{pairCostMs, tuneSkin};
     ParallelFor(activeParticles, [&](int i) {
       Vec3  xsph = {0.0f, 0.0f, 0.0f};
       float wSum = 0.0f;
 
-      int* myNeighbours = &neighbourData[i * MAX_NEIGHBOURS];
-      for (int k = 0; k < neighbourCount[i]; ++k) {
-	int j = myNeighbours[k];
-	if (j == i)
-	  continue;
-
-	Vec3  diff = predictedPositions[i] - predictedPositions[j];
-	float d2   = diff.Dot(diff);
-	if (d2 >= h2)
-	  continue;
-
-        float sq = h2 - d2;
-	float w  = poly6 * sq * sq * sq;
-	xsph += (velocities[j] - velocities[i]) * w;
-	wSum += w;
+      if (solverKernels) {
+        KernelVec sum;
+        solverKernels->xsph(i, neighbourData.data(), neighbourStart[i], neighbourStart[i + 1],
+                            PositionColumns(), VelocityColumns(), kc, sum, wSum);
+        xsph = Vec3{sum.x, sum.y, sum.z};
+      } else {
+        for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+          int j = neighbourData[k];
+          if (j == i)
+            continue;
+
+          float w;
+          if (pairCacheActive) {
+            w = pairW[k];
+            if (w == 0.0f)
+              continue;
+          } else {
+            Vec3  diff = predictedPositions[i] - predictedPositions[j];
+            float d2   = diff.Dot(diff);
+            if (d2 >= h2)
+              continue;
+
+            float sq = h2 - d2;
+            w        = poly6 * sq * sq * sq;
+          }
+          xsph += (velocities[j] - velocities[i]) * w;
+          wSum += w;
+        }
       }
       if (wSum > 1e-6f)
 	xsph = xsph * (1.0f / wSum);
@@ -401,9 +806,13 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
       if (mag > maxDv)
         dv = dv * (maxDv / mag);
       
-      velocities[i] += dv;
-      //newVelocities[i] = velocities[i] + dv;
+      if (jacobiSolver)
+        velocitiesBack[i] = velocities[i] + dv;
+      else
+        velocities[i] += dv;
     });
+    if (jacobiSolver)
+      SwapJacobiBuffers(velocities, velocitiesBack);
 #endif
   }
   
@@ -415,52 +824,8 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
     CudaBuffers& cb = *as->cudaBuffers;
     gpuVorticity(cb, smoothingRadius, vorticityEpsilon, dt, activeParticles);
 #else
-    ParallelFor(activeParticles, [&](int i) {
-      Vec3 omega = {0.0f, 0.0f, 0.0f};
-      //const Vec3& vi    = newVelocities[i];
-      const Vec3& vi = velocities[i];
-
-      int* myNeighbours = &neighbourData[i * MAX_NEIGHBOURS];
-      for (int k = 0; k < neighbourCount[i]; ++k) {
-	int j = myNeighbours[k];
-	if (j == i) continue;
-
-	Vec3  diff = predictedPositions[i] - predictedPositions[j];
-	float d2   = diff.Dot(diff);
-	if (d2 < 1e-12f || d2 >= h2) continue;
-
-	float d     = std::sqrt(d2);
-	float s     = (smoothingRadius - d) * (smoothingRadius - d) / d;
-	Vec3  gradW = diff * s;
-        //Vec3 vij = newVelocities[j] - vi;
-	Vec3 vij = velocities[j] - vi;
-       
-	omega.x += vij.y * gradW.z - vij.z * gradW.y;
-	omega.y += vij.z * gradW.x - vij.x * gradW.z;
-	omega.z += vij.x * gradW.y - vij.y * gradW.x;
-      }
-      vorticity[i] = omega;
-
-      // Pass 2: apply vorticity confinement force
-      Vec3 eta = {0.0f, 0.0f, 0.0f};
-
-      //int* myNeighbours = &neighbourData[i * MAX_NEIGHBOURS];
-      for (int k = 0; k < neighbourCount[i]; ++k) {
-	int j = myNeighbours[k];
-	if (j == i) continue;
-
-	Vec3  diff = predictedPositions[i] - predictedPositions[j];
-	float d2   = diff.Dot(diff);
-	if (d2 < 1e-12f || d2 >= h2) continue;
-
-	float d     = std::sqrt(d2);
-	float s     = (smoothingRadius - d) * (smoothingRadius - d) / d;
-	Vec3  gradW = diff * s;
-
-	float omegaMag = vorticity[j].Magnitude();
-	eta += gradW * omegaMag;
-      }
-
+    CostTimer cost{pairCostMs, tuneSkin};
+    auto applyConfinement = [&](int i, Vec3 eta) {
       float etaMag = eta.Magnitude();
       if (etaMag < 1e-6f) return;
 
@@ -468,15 +833,213 @@ void Particles::Update(float dt, float smoothingRadius, float radiusPx,
 
       const Vec3& w = vorticity[i];
       Vec3 f_vorticity = {
-	N.y * w.z - N.z * w.y,
-	N.z * w.x - N.x * w.z,
-	N.x * w.y - N.y * w.x
+        N.y * w.z - N.z * w.y,
+        N.z * w.x - N.x * w.z,
+        N.x * w.y - N.y * w.x
       };
       //newVelocities[i] += f_vorticity * (vorticityEpsilon * dt);
       velocities[i] += f_vorticity * (vorticityEpsilon * dt);
+    };
+
+    // Scalar pass 1 / pass 2 sums for particle i
+    auto curlAt = [&](int i) {
+      Vec3 omega = {0.0f, 0.0f, 0.0f};
+      const Vec3& vi = velocities[i];
+
+      for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+        int j = neighbourData[k];
+        if (j == i) continue;
+
+        Vec3 gradW;
+        if (pairCacheActive) {
+          if (pairGradS[k] == 0.0f) continue;
+          gradW = pairDiff[k] * pairGradS[k];
+        } else {
+          Vec3  diff = predictedPositions[i] - predictedPositions[j];
+          float d2   = diff.Dot(diff);
+          if (d2 < 1e-12f || d2 >= h2) continue;
+
+          float d = std::sqrt(d2);
+          float s = (smoothingRadius - d) * (smoothingRadius - d) / d;
+          gradW   = diff * s;
+        }
+        Vec3 vij = velocities[j] - vi;
+
+        omega.x += vij.y * gradW.z - vij.z * gradW.y;
+        omega.y += vij.z * gradW.x - vij.x * gradW.z;
+        omega.z += vij.x * gradW.y - vij.y * gradW.x;
+      }
+      return omega;
+    };
+    auto etaAt = [&](int i) {
+      Vec3 eta = {0.0f, 0.0f, 0.0f};
+
+      for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+        int j = neighbourData[k];
+        if (j == i) continue;
+
+        Vec3 gradW;
+        if (pairCacheActive) {
+          if (pairGradS[k] == 0.0f) continue;
+          gradW = pairDiff[k] * pairGradS[k];
+        } else {
+          Vec3  diff = predictedPositions[i] - predictedPositions[j];
+          float d2   = diff.Dot(diff);
+          if (d2 < 1e-12f || d2 >= h2) continue;
+
+          float d = std::sqrt(d2);
+          float s = (smoothingRadius - d) * (smoothingRadius - d) / d;
+          gradW   = diff * s;
+        }
+        eta += gradW * vorticity[j].Magnitude();
+      }
+      return eta;
+    };
+
+    if (solverKernels || jacobiSolver) {
+      // The two passes run as separate sweeps, so eta always sees this frame's
+      // vorticity of every neighbour and no thread reads a velocity another
+      // one is writing. Pass 2 only updates velocities[i] itself.
+      if (solverKernels)
+        SyncVelocityColumns();
+      ParallelFor(activeParticles, [&](int i) {
+        if (solverKernels) {
+          KernelVec o = solverKernels->curl(i, neighbourData.data(), neighbourStart[i],
+                                            neighbourStart[i + 1], PositionColumns(),
+                                            VelocityColumns(), kc);
+          vorticity[i] = Vec3{o.x, o.y, o.z};
+          omegaMag[i]  = vorticity[i].Magnitude();
+        } else {
+          vorticity[i] = curlAt(i);
+        }
+      });
+      ParallelFor(activeParticles, [&](int i) {
+        if (solverKernels) {
+          KernelVec e = solverKernels->eta(i, neighbourData.data(), neighbourStart[i],
+                                           neighbourStart[i + 1], PositionColumns(),
+                                           omegaMag.data(), kc);
+          applyConfinement(i, Vec3{e.x, e.y, e.z});
+        } else {
+          applyConfinement(i, etaAt(i));
+        }
+      });
+    } else {
+      ParallelFor(activeParticles, [&](int i) {
+        vorticity[i] = curlAt(i);
+        applyConfinement(i, etaAt(i));
+      });
+    }
+#endif
+  }
+
+#ifndef USE_CUDA
+  // 7. collisions once on the final state: pushes the positions and
+  // reflects the velocities the next step integrates
+  if (collisionSchedule == CollisionSchedule::END_OF_STEP) {
+    collisionSkips += ProjectCollisions(positions.data(), velocities.data(), colliders, as);
+    ++collisionPasses;
+  }
+#endif
+
+#ifndef USE_CUDA
+  TuneSkinRadius(smoothingRadius, pairCostMs, rebuilt);
+  Profiler::Record(SKIN_RADIUS, currentFrame, verletLists ? skinRadius : 0.0, isBenchmarking);
+  Profiler::Record(REBUILD_RATE, currentFrame, rebuildRate, isBenchmarking);
+  if (!useTriangleCollisions) {
+    collisionSkipRate = activeParticles > 0 && collisionPasses > 0
+      ? (float)collisionSkips / ((float)activeParticles * collisionPasses) : 0.0f;
+    Profiler::Record(COLLISION_SKIP_RATE, currentFrame, collisionSkipRate, isBenchmarking);
+    // an extra pass over the particles, so only when it is logged
+    if (isBenchmarking)
+      Profiler::Record(PENETRATION_DEPTH, currentFrame, MaxPenetration(colliders), isBenchmarking);
+  }
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// One collision pass over pos / vel (the predicted positions inside the
+// solver, the final ones at the end of a step). Returns how many particles
+// their CollisionBound let skip.
+int Particles::ProjectCollisions(Vec3* pos, Vec3* vel, SDFCollider* colliders, AppState* as)
+{
+  std::atomic<int> skipped{0};
+  if (!useTriangleCollisions) {
+    Profiler::Timer timer(COLLISION_SDF, currentFrame, isBenchmarking);
+#ifdef USE_CUDA
+    // the kernels work on the device copy of the predicted positions
+    CudaBuffers& cb = *as->cudaBuffers;
+    gpuProjectParticleSDF(cb, activeParticles);
+#else
+    // packets of consecutive particles; a chunk still spans about
+    // parallelGrain particles
+    const int numPackets = (activeParticles + COLLIDER_PACKET - 1) / COLLIDER_PACKET;
+    CollisionBound* bounds = collisionCache ? collisionBounds.data() : nullptr;
+    ParallelFor(numPackets, std::max(1, parallelGrain / COLLIDER_PACKET), [&](int packet) {
+      const int first = packet * COLLIDER_PACKET;
+      const int count = std::min(COLLIDER_PACKET, activeParticles - first);
+      int skips = 0;
+      if (bucketedColliders) {
+        skips = colliderBuckets.ProjectPacket(&pos[first], &vel[first], count,
+                                              bounds ? bounds + first : nullptr);
+      } else {
+        for (int i = first; i < first + count; ++i) {
+          if (bounds && bounds[i].Covers(pos[i])) {
+            ++skips;
+            continue;
+          }
+          const int *begin, *end;
+          colliderBroadphase.Candidates(pos[i], begin, end);
+          float bound = colliderBroadphase.Clearance(pos[i]);
+          for (const int* j = begin; j != end; ++j)
+            bound = std::min(bound, ProjectParticleSDF(pos[i], vel[i], colliders[*j]));
+          if (bounds)
+            bounds[i].Store(pos[i], bound);
+        }
+      }
+      if (skips)
+        skipped += skips;
+    });
+#endif
+#ifndef USE_CUDA
+  } else if (useTriangleBVH) {
+    Profiler::Timer timer(COLLISION_TRI_BVH, currentFrame, isBenchmarking);
+    ParallelFor(activeParticles, [&](int i) {
+      for (const TriCollider &collider : gTriColliders)
+        ProjectParticleTriBVH(pos[i], vel[i], collider, gClosestPoints[i]);
+    });
+#endif
+  } else {
+    Profiler::Timer timer(COLLISION_TRI_BRUTE, currentFrame,
+                          isBenchmarking);
+#ifdef USE_CUDA
+    CudaBuffers &cb = *as->cudaBuffers;
+    gpuProjectParticleTri(cb, gClosestPoints.data(), activeParticles);
+#else
+    ParallelFor(activeParticles, [&](int i) {
+      for (const TriCollider &collider : gTriColliders)
+        ProjectParticleTri(pos[i], vel[i], collider, gClosestPoints[i]);
     });
 #endif
   }
+  return skipped;
+}
+
+// Deepest any particle sits inside an SDF collider. Particles their bound
+// covers are outside every collider and are not evaluated.
+float Particles::MaxPenetration(const SDFCollider* colliders)
+{
+  const CollisionBound* bounds = collisionCache ? collisionBounds.data() : nullptr;
+  return ParallelMax(activeParticles, [&](int i) {
+    const Vec3& p = positions[i];
+    if (bounds && bounds[i].Covers(p))
+      return 0.0f;
+    const int *begin, *end;
+    colliderBroadphase.Candidates(p, begin, end);
+    float depth = 0.0f;
+    for (const int* j = begin; j != end; ++j)
+      depth = std::max(depth, -SDFColliderDistance(p, colliders[*j]));
+    return depth;
+  });
 }
 
 // ---------------------------------------------------------------------------
@@ -500,9 +1063,8 @@ float Particles::CalculateDensity(size_t i, float smoothingRadius)
 {
   float density = poly6 * h2 * h2 * h2;  // self
 
-  int* myNeighbours = &neighbourData[i * MAX_NEIGHBOURS];
-  for (int k = 0; k < neighbourCount[i]; ++k) {
-    int j = myNeighbours[k];
+  for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+    int j = neighbourData[k];
     if (j == (int)i) continue;
 
     Vec3  diff = predictedPositions[i] - predictedPositions[j];
@@ -552,7 +1114,8 @@ void Particles::Reset(float smoothingRadius, AppState* as)
 #else
   BuildGrid(smoothingRadius);
   BuildNeighbours(smoothingRadius);
-  positionsAtLastBuild = predictedPositions;
+  framesSinceReorder = 0;
+  spreadAtReorder = NeighbourIndexSpread();
   restDensity = EstimateRestDensity(smoothingRadius);
 #endif
   if (tricklerMode) {
@@ -607,23 +1170,179 @@ void Particles::TickTrickler(Vec3* positions, Vec3* predictedPositions, Vec3* ve
   }
 }
 
+// ---------------------------------------------------------------------------
+// Jacobi mode: a pass wrote [0, activeParticles) of back from front. Carry the
+// inactive tail over and swap, so the buffers trade places without a copy.
+void Particles::SwapJacobiBuffers(std::vector<Vec3>& front, std::vector<Vec3>& back)
+{
+  std::copy(front.begin() + activeParticles, front.end(), back.begin() + activeParticles);
+  front.swap(back);
+}
+
 // ---------------------------------------------------------------------------
 void Particles::ResetTrickler()
 {
+  // deterministic runs also need a reproducible spawn jitter
+  if (jacobiSolver)
+    rng.seed(TRICKLER_SEED);
   activeParticles = 0;
   nextRecycleIdx  = 0;
   tricklerAccum   = 0.0f;
 }
 
 // ---------------------------------------------------------------------------
+void Particles::BuildMortonCellOrder()
+{
+  const int numCells = numCells1D * numCells1D * numCells1D;
+  std::vector<std::pair<unsigned int, int>> keyed(numCells);
+  for (int cx = 0; cx < numCells1D; ++cx)
+    for (int cy = 0; cy < numCells1D; ++cy)
+      for (int cz = 0; cz < numCells1D; ++cz) {
+        int idx = CellIndex(cx, cy, cz, numCells1D);
+        keyed[idx] = {MortonCode(cx, cy, cz), idx};
+      }
+  std::sort(keyed.begin(), keyed.end());
+
+  mortonCellOrder.resize(numCells);
+  for (int c = 0; c < numCells; ++c)
+    mortonCellOrder[c] = keyed[c].second;
+}
+
+// Mean |i - j| over a sample of neighbour pairs. Grows as particles mix and
+// neighbours drift apart in memory.
+float Particles::NeighbourIndexSpread()
+{
+  constexpr int stride = 64;
+  double sum = 0.0;
+  long long pairs = 0;
+  for (int i = 0; i < activeParticles; i += stride) {
+    for (int k = neighbourStart[i]; k < neighbourStart[i + 1]; ++k) {
+      sum += std::abs(neighbourData[k] - i);
+      ++pairs;
+    }
+  }
+  return pairs > 0 ? (float)(sum / pairs) : 0.0f;
+}
+
+bool Particles::NeedsReorder()
+{
+  ++framesSinceReorder;
+  if (activeParticles < 2) return false;
+  if (reorderInterval > 0 && framesSinceReorder >= reorderInterval) return true;
+  if (reorderDegradeFactor > 0.0f && spreadAtReorder > 0.0f)
+    return NeighbourIndexSpread() > reorderDegradeFactor * spreadAtReorder;
+  return false;
+}
+
+template<typename T>
+void Particles::Permute(std::vector<T>& data, std::vector<T>& scratch)
+{
+  if ((int)data.size() != numParticles) return;
+  scratch.resize(numParticles);
+  ParallelFor(numParticles, [&](int i) {
+    scratch[i] = data[reorderNewToOld[i]];
+  });
+  data.swap(scratch);
+}
+
+// Sorts the active particles by the Morton code of their grid cell. The grid
+// built this frame already groups particles by cell, so walking its cells in
+// Z-order yields the permutation without a comparison sort. Inactive particles
+// keep their slots so the trickler can keep appending.
+void Particles::ReorderParticles()
+{
+  reorderNewToOld.resize(numParticles);
+  reorderOldToNew.resize(numParticles);
+
+  int next = 0;
+  for (int cell : mortonCellOrder)
+    for (int k = gridStart[cell]; k < gridStart[cell + 1]; ++k)
+      reorderNewToOld[next++] = gridData[k];
+  for (int i = activeParticles; i < numParticles; ++i)
+    reorderNewToOld[i] = i;
+
+  ParallelFor(numParticles, [&](int i) {
+    reorderOldToNew[reorderNewToOld[i]] = i;
+  });
+
+  Permute(positions, reorderScratch);
+  Permute(predictedPositions, reorderScratch);
+  Permute(velocities, reorderScratch);
+  Permute(oldPositions, reorderScratch);
+  Permute(vorticity, reorderScratch);
+  Permute(positionsAtLastBuild, reorderScratch);
+  Permute(particleCell, reorderScratchInt);
+  Permute(neighbourCount, reorderScratchInt);
+
+  ParallelFor((int)gridData.size(), [&](int k) {
+    gridData[k] = reorderOldToNew[gridData[k]];
+  });
+
+  // neighbour lists move with their owner and point at the new indices
+  reorderScratchStart.resize(numParticles + 1);
+  ExclusiveScan(neighbourCount.data(), reorderScratchStart.data(), numParticles);
+  reorderScratchInt.resize(neighbourData.size());
+  ParallelFor(activeParticles, [&](int i) {
+    const int* src = &neighbourData[neighbourStart[reorderNewToOld[i]]];
+    int* dst = &reorderScratchInt[reorderScratchStart[i]];
+    for (int k = 0; k < neighbourCount[i]; ++k)
+      dst[k] = reorderOldToNew[src[k]];
+  });
+  neighbourStart.swap(reorderScratchStart);
+  neighbourData.swap(reorderScratchInt);
+
+  if (nextRecycleIdx < activeParticles)
+    nextRecycleIdx = reorderOldToNew[nextRecycleIdx];
+
+  framesSinceReorder = 0;
+  spreadAtReorder = NeighbourIndexSpread();
+}
+
+// ---------------------------------------------------------------------------
+// Two particles closing on each other can each cover half the skin before a
+// pair outside the list comes within h, so that is the rebuild threshold.
 bool Particles::NeedsNeighbourRebuild()
 {
-  if ((int)positionsAtLastBuild.size() < activeParticles) return true;
-  for (int i = 0; i < activeParticles; ++i) {
+  if (!verletLists || needsRebuild || activeParticles != activeAtLastBuild ||
+      (int)positionsAtLastBuild.size() < activeParticles)
+    return true;
+
+  float maxMove2 = ParallelMax(activeParticles, [&](int i) {
     Vec3 diff = predictedPositions[i] - positionsAtLastBuild[i];
-    if (diff.Dot(diff) > skinRadius * skinRadius) return true;
+    return diff.Dot(diff);
+  });
+  float halfSkin = 0.5f * builtSkin;
+  return maxMove2 > halfSkin * halfSkin;
+}
+
+// Tracks the rebuild rate over each window and, with auto-tuning on, hill
+// climbs on the measured per-frame cost of neighbour builds plus the pair
+// loops: a bigger skin rebuilds less often but every solver pass walks more
+// pairs that fall outside h. Each window keeps stepping the skin the same way
+// while the cost drops and turns around when it rises.
+void Particles::TuneSkinRadius(float smoothingRadius, double frameCostMs, bool rebuilt)
+{
+  ++tuneFrames;
+  tuneRebuilds += rebuilt ? 1 : 0;
+  tuneCostMs   += frameCostMs;
+  if (tuneFrames < SKIN_TUNE_WINDOW) return;
+
+  double cost = tuneCostMs / tuneFrames;
+  rebuildRate = (float)tuneRebuilds / tuneFrames;
+  tuneFrames   = 0;
+  tuneRebuilds = 0;
+  tuneCostMs   = 0.0;
+  if (!verletLists || !skinAutoTune || jacobiSolver) {
+    lastWindowCost = -1.0;
+    return;
   }
-  return false;
+
+  if (lastWindowCost >= 0.0 && cost > lastWindowCost)
+    skinStep = 1.0f / skinStep;
+  lastWindowCost = cost;
+
+  skinRadius = std::clamp(skinRadius * skinStep, SKIN_MIN_FRACTION * smoothingRadius,
+                          SKIN_MAX_FRACTION * smoothingRadius);
 }
 
 // ---------------------------------------------------------------------------
@@ -645,10 +1364,8 @@ void Particles::ResizeParticles(int newParticles, float smoothingRadius,
   deltas.resize(newParticles);
   oldPositions.resize(newParticles);
   vorticity.resize(newParticles, Vec3{0.0f, 0.0f, 0.0f});
-  neighbourData.resize(newParticles * MAX_NEIGHBOURS);
   neighbourCount.resize(newParticles, 0);
-  indices.resize(newParticles);
-  std::iota(indices.begin(), indices.end(), 0);
+  neighbourStart.resize(newParticles + 1, 0);
 
   // Resize grid arrays for new nCells1D (smoothing radius unchanged here,
   // but guard in case caller changes it later)
@@ -660,7 +1377,8 @@ void Particles::ResizeParticles(int newParticles, float smoothingRadius,
   InitialiseParticles(newParticles, initSpacing);
   BuildGrid(smoothingRadius);
   BuildNeighbours(smoothingRadius);
-  positionsAtLastBuild = predictedPositions;
+  framesSinceReorder = 0;
+  spreadAtReorder = NeighbourIndexSpread();
 
 
 #ifdef USE_CUDA
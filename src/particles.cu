@@ -646,11 +646,12 @@ void gpuClampToBoundaries(CudaBuffers &cb, float radiusPx, int g_fb_w,
 }
 
 __global__ void projectParticleSDFKernel(Vec3 *positions, Vec3 *velocities,
-                                         SDFCollider *colliders, int activeParticles) {
+                                         SDFCollider *colliders, int numColliders,
+                                         int activeParticles) {
   int i = threadIdx.x + blockDim.x * blockIdx.x;
 
   if (i < activeParticles) {
-    for (size_t j{}; j < MAX_OBJECTS; ++j) {
+    for (int j{}; j < numColliders; ++j) {
       SDFCollider* collider = &colliders[j];
       if (collider->type == RGObjectType::BOX)
         continue;
@@ -680,22 +681,30 @@ __global__ void gpuProjectParticleTri(TriCollider* triColliders, Vec3* predicted
 
   if (i < activeParticles) {
     for (size_t j{}; j < MAX_OBJECTS; ++j) {
+      const TriCollider& collider = triColliders[j];
       float minDistanceSquared = CUDART_INF_F;
       Vec3 closestPoint = Vec3{0.0f, 0.0f, 0.0f};
+      // the mesh is shared by all instances and stored in local space
+      Vec3 d = predictedPositions[i] - collider.worldPosition;
+      Vec3 localPosition = {d.Dot(collider.rotationAxes[0]),
+                            d.Dot(collider.rotationAxes[1]),
+                            d.Dot(collider.rotationAxes[2])};
 
-      for (size_t k{}; k + 2 < triColliders[j].count; k += 3) {
+      for (size_t k{}; k + 2 < collider.count; k += 3) {
         Vec3 q = ClosestPtPointTriangle(
-            predictedPositions[i], triColliders[j].triangles[k],
-            triColliders[j].triangles[k + 1], triColliders[j].triangles[k + 2]);
+            localPosition, collider.triangles[k],
+            collider.triangles[k + 1], collider.triangles[k + 2]);
 
-        Vec3 diff = predictedPositions[i] - q;
+        Vec3 diff = localPosition - q;
         float distanceSquared = diff.Dot(diff);
         if (distanceSquared < minDistanceSquared) {
           minDistanceSquared = distanceSquared;
 	  closestPoint = q;
 	}
       }
-      closestPointsOut[i] = closestPoint;
+      closestPointsOut[i] = collider.worldPosition + collider.rotationAxes[0] * closestPoint.x +
+                            collider.rotationAxes[1] * closestPoint.y +
+                            collider.rotationAxes[2] * closestPoint.z;
     }
   }
 }
@@ -707,7 +716,7 @@ void gpuProjectParticleSDF(CudaBuffers &cb, int activeParticles) {
 
   HANDLE_ERROR(cudaEventRecord(start));
   projectParticleSDFKernel<<<ceil(activeParticles / 128.0), 128>>>(
-      cb.predictedPositions_d, cb.velocities_d, cb.colliders_d,
+      cb.predictedPositions_d, cb.velocities_d, cb.colliders_d, cb.colliderCount,
       activeParticles);
   CUDA_CHECK_LAST();
   HANDLE_ERROR(cudaEventRecord(stop));
@@ -768,6 +777,21 @@ void gpuUpdateVelocities(CudaBuffers &cb, Vec3 *positions_h, float dt,
 
 
 
+__global__ void packInstancesKernel(const Vec3 *positions, const Vec3 *velocities,
+                                    PackedInstance *out, int activeParticles) {
+  int i = threadIdx.x + blockDim.x * blockIdx.x;
+  if (i < activeParticles)
+    out[i] = PackInstance(positions[i], velocities[i]);
+}
+
+void gpuPackInstances(const Vec3 *positions_d, const Vec3 *velocities_d,
+                      PackedInstance *out_d, int activeParticles) {
+  if (activeParticles <= 0) return;
+  packInstancesKernel<<<(activeParticles + 127) / 128, 128>>>(positions_d, velocities_d, out_d,
+                                                             activeParticles);
+  CUDA_CHECK_LAST();
+}
+
 __global__ void viscocityKernel(Vec3 *predictedPositions, Vec3 *velocities,
                                 int *neighbourData, int *neighbourCount,
                                 float h2, float xsphC, int activeParticles) {
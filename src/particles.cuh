@@ -32,6 +32,11 @@ void gpuProjectParticleTri(CudaBuffers &cb, Vec3 *closestPoints_h, int activePar
 void gpuUpdateVelocities(CudaBuffers &cb, Vec3 *positions_h,
                          float dt, float mSpeed, int activeParticles);
 
+// Render instances of the first activeParticles into out_d, which may be a
+// mapped GL buffer
+void gpuPackInstances(const Vec3* positions_d, const Vec3* velocities_d,
+                      PackedInstance* out_d, int activeParticles);
+
 void gpuViscosity(CudaBuffers &cb, Vec3 *velocities_h, float h2, float xsphC,
                   int activeParticles);
 
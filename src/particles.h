@@ -5,21 +5,29 @@
 #include <unordered_map>
 #include <array>
 #include "linear_algebra.h"
+#include "aligned_allocator.h"
 #include "helpers.h"
 #include "cell.h"
 #include <numeric>
 #include "particle_config.h"
+#include "packed_instance.h"
 #include "../benchmark/profiler.h"
 #include "objects3d/sdf_collision.h"
+#include "objects3d/collider_broadphase.h"
+#include "objects3d/collider_buckets.h"
 
+#include "thread_pool.h"
 #ifdef USE_TBB
 #include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 #include <tbb/blocked_range.h>
+#include <tbb/task_arena.h>
 #else
 #include <execution>
 #endif
 #include <algorithm>
 #include <random>
+#include <thread>
 
 #ifdef USE_CUDA
 #include <cuda_runtime.h>
@@ -32,29 +40,110 @@ extern int currentFrame;
 extern bool runParallel;
 
 extern bool useTriangleCollisions;
+extern bool useTriangleBVH;   // CPU: TriCollider::bvh closest-point queries with projection instead of the brute scan
 extern std::vector<TriCollider> gTriColliders;
 extern std::vector<Vec3> gClosestPoints;
 
 struct Particles
 {
 
+  // Runs func(i) for i in [0, n) on the selected backend, or in order on
+  // the calling thread when runParallel is off
   template<typename F>
   void ParallelFor(int n, F&& func) {
+    ParallelFor(n, parallelGrain, func);
+  }
+
+  // Same with grain items per work chunk, for loops whose items are
+  // themselves batches of particles (ignored by the STD backend)
+  template<typename F>
+  void ParallelFor(int n, int grain, F&& func) {
+    if (!runParallel) {
+      for (int i = 0; i < n; ++i)
+        func(i);
+      return;
+    }
+    switch (parallelBackend) {
 #ifdef USE_TBB
-    tbb::parallel_for(tbb::blocked_range<int>(0, n),
-        [&](const tbb::blocked_range<int>& range) {
-            for (int i = range.begin(); i < range.end(); ++i)
-                func(i);
-        });
+    case ParallelBackend::TBB:
+      tbb::parallel_for(tbb::blocked_range<int>(0, n, std::max(1, grain)),
+          [&](const tbb::blocked_range<int>& range) {
+              for (int i = range.begin(); i < range.end(); ++i)
+                  func(i);
+          });
+      return;
 #else
+    case ParallelBackend::STD:
+      ForEachChunk(n, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i)
+          func(i);
+      });
+      return;
+#endif
+    default:
+      Pool().ParallelFor(n, grain, func);
+    }
+  }
+
+  // Maximum of func(i) over [0, n), 0 when n == 0
+  template<typename F>
+  float ParallelMax(int n, F&& func) {
+    auto maxOp = [](float a, float b) { return std::max(a, b); };
     if (!runParallel) {
-      std::for_each(indices.begin(), indices.begin() + n,
-        [&](int i) { func(i); });
-    } else {
-      std::for_each(std::execution::par_unseq, indices.begin(), indices.begin() + n,
-                    [&](int i) { func(i); });
+      float m = 0.0f;
+      for (int i = 0; i < n; ++i)
+        m = std::max(m, func(i));
+      return m;
+    }
+    switch (parallelBackend) {
+#ifdef USE_TBB
+    case ParallelBackend::TBB:
+      return tbb::parallel_reduce(
+          tbb::blocked_range<int>(0, n, std::max(1, parallelGrain)), 0.0f,
+          [&](const tbb::blocked_range<int>& range, float m) {
+              for (int i = range.begin(); i < range.end(); ++i)
+                  m = std::max(m, func(i));
+              return m;
+          },
+          maxOp);
+#else
+    case ParallelBackend::STD: {
+      std::vector<float> partial(STD_MAX_CHUNKS, 0.0f);
+      ForEachChunk(n, [&](int begin, int end, int chunk) {
+        for (int i = begin; i < end; ++i)
+          partial[chunk] = std::max(partial[chunk], func(i));
+      });
+      return std::reduce(partial.begin(), partial.end(), 0.0f, maxOp);
     }
 #endif
+    default: {
+      ThreadPool& pool = Pool();
+      std::vector<float> partial(pool.ThreadCount(), 0.0f);
+      pool.ParallelForChunks(n, parallelGrain, [&](int begin, int end, int participant) {
+        float m = partial[participant];
+        for (int i = begin; i < end; ++i)
+          m = std::max(m, func(i));
+        partial[participant] = m;
+      });
+      return std::reduce(partial.begin(), partial.end(), 0.0f, maxOp);
+    }
+    }
+  }
+
+  // Threads the current backend runs on, used to size per-thread work
+  static int ParallelThreadCount() {
+    if (!runParallel) return 1;
+    switch (parallelBackend) {
+#ifdef USE_TBB
+    case ParallelBackend::TBB:
+      return tbb::this_task_arena::max_concurrency();
+#else
+    case ParallelBackend::STD:
+      return std::max(1, (int)std::thread::hardware_concurrency());
+#endif
+    default:
+      return Pool().ThreadCount();
+    }
   }
 
   int numParticles;
@@ -71,28 +160,89 @@ struct Particles
   std::vector<Vec3>  deltas;
   std::vector<Vec3>  oldPositions;
   std::vector<Vec3> vorticity;
-  std::vector<float> omegaMag;
+  std::vector<float> omegaMag;      // |vorticity|, read by the SIMD eta kernel
+
+  // Jacobi mode write targets, swapped with the front arrays after each pass
+  std::vector<Vec3>  predictedBack;
+  std::vector<Vec3>  velocitiesBack;
 
   std::vector<int> gridData;
   std::vector<int> gridStart;
   std::vector<int> gridCount;
+  std::vector<int> particleCell;    // flat cell index per particle, written by BuildGrid
+  std::vector<int> chunkCellCount;  // per-chunk histograms, numChunks * numCells
+  std::vector<int> scanBlockSum;    // per-block totals for ExclusiveScan
+
+  // CSR neighbour lists: particle i's neighbours are
+  // neighbourData[neighbourStart[i] .. neighbourStart[i + 1])
+  std::vector<int> neighbourData;   // packed indices, size = total pair count
+  std::vector<int> neighbourStart;  // size nParticles + 1
+  std::vector<int> neighbourCount;  // size nParticles
+
+  // SoA mirror of predicted positions and velocities for the SIMD solver
+  // kernels, refreshed from the AoS arrays before each pass that reads them
+  AlignedVector<float> posX, posY, posZ;
+  AlignedVector<float> velX, velY, velZ;
+  KernelFamily         activeKernelFamily = KernelFamily::SCALAR;
+  const SolverKernels* solverKernels = nullptr;  // nullptr: scalar loops
+  bool                 pairCacheActive = false;  // usePairCache, unless solverKernels are set
+
+  // Pair cache, parallel to neighbourData (see RefreshPairCache)
+  std::vector<Vec3>  pairDiff;
+  std::vector<float> pairW;
+  std::vector<float> pairGradS;
+
+  // SDF colliders near each broadphase cell, rebuilt when colliders change
+  ColliderBroadphase colliderBroadphase;
+  // The same colliders grouped by type for the packet pass
+  ColliderBuckets colliderBuckets;
+
+  // Per particle: how far it may move before the collision pass must look
+  // at it again (see CollisionBound); cleared when colliders change
+  std::vector<CollisionBound> collisionBounds;
+  float collisionSkipRate = 0.0f; // share of collision tests skipped last frame
 
-  std::vector<int> neighbourData;   // size nParticles * MAX_NEIGHBOURS
-  std::vector<int> neighbourCount;  // size nParticles 
-  std::vector<int> indices;
   std::vector<Vec3> positionsAtLastBuild;
   float skinRadius;
+  float builtSkin = 0.0f;         // skin the current lists were built with
+  int   activeAtLastBuild = 0;
   bool needsRebuild = true;
 
+  // Verlet skin tuning, measured over windows of SKIN_TUNE_WINDOW frames
+  int    tuneFrames      = 0;
+  int    tuneRebuilds    = 0;
+  double tuneCostMs      = 0.0;   // neighbour build + pair loop time in window
+  double lastWindowCost  = -1.0;  // per-frame cost of the previous window
+  float  skinStep        = 1.1f;  // multiplicative step, < 1 shrinks the skin
+  float  rebuildRate     = 0.0f;  // rebuilds per frame over the last window
+
+  // Morton reordering
+  std::vector<int>  mortonCellOrder;   // flat cell indices sorted by Z-order
+  std::vector<int>  reorderNewToOld;
+  std::vector<int>  reorderOldToNew;
+  std::vector<Vec3> reorderScratch;
+  std::vector<int>  reorderScratchInt;
+  std::vector<int>  reorderScratchStart;
+  int   framesSinceReorder = 0;
+  float spreadAtReorder    = 0.0f;
+
   float h2, h5, h8, poly6, spiky, wDq;
 
   Particles(int numParticles, float smoothingRadius);
   void Update(float dt, float smoothingRadius, float radiusPx,
                 const int g_fb_w,
-	      const int g_fb_h, Vec3 rayOrigin, Vec3 rayDir, float mouseStrength, SDFCollider* colliders, AppState* as);
+	      const int g_fb_h, Vec3 rayOrigin, Vec3 rayDir, float mouseStrength, SDFCollider* colliders,
+	      int numColliders, AppState* as);
   void Reset(float smoothingRadius, AppState* as);
   void ResizeParticles(int newParticles, float smoothingRadius, float spacing, float ox, float oy, float oz, AppState* as);
   void ResetTrickler();
+  size_t NeighbourMemoryBytes() const;
+  size_t PairCacheBytes() const;
+  // Quantises the first activeParticles into out (see PackedInstance), one
+  // sweep over positions and velocities. While the spatial grid still
+  // describes them they go out in grid order with one InstanceCell per
+  // occupied cell; otherwise in particle order with cells left empty.
+  void PackInstances(PackedInstance* out, std::vector<InstanceCell>& cells);
 
   
 
@@ -107,10 +257,66 @@ private:
   float CalculateDistance(Vec3 posA, Vec3 posB);
   float CalculateDensity(size_t particleIdx, float smoothingRadius);
   void  BuildGrid(float smoothingRadius);
+  int   GridChunkCount() const;
+  void  ExclusiveScan(const int* counts, int* offsets, int n);
+  static ThreadPool& Pool() {
+    ThreadPool& pool = GlobalThreadPool();
+    pool.Configure(poolThreads, pinThreads);
+    return pool;
+  }
+
+#ifndef USE_TBB
+  // std::execution has no ranges, so it walks chunk ids: chunk c covers
+  // [n * c / chunks, n * (c + 1) / chunks)
+  template<typename F>
+  void ForEachChunk(int n, F&& func) {
+    static const std::vector<int> chunkIds = [] {
+      std::vector<int> ids(STD_MAX_CHUNKS);
+      std::iota(ids.begin(), ids.end(), 0);
+      return ids;
+    }();
+    const int grain  = std::max(1, parallelGrain);
+    const int chunks = std::clamp((n + grain - 1) / grain, 1, STD_MAX_CHUNKS);
+    std::for_each(std::execution::par_unseq, chunkIds.begin(), chunkIds.begin() + chunks,
+                  [&](int c) {
+                    func((int)((int64_t)n * c / chunks), (int)((int64_t)n * (c + 1) / chunks), c);
+                  });
+  }
+#endif
+
+  template<typename F>
+  void  ForEachCandidate(int i, float smoothingRadius, float radius, F&& func);
+  void  BuildMortonCellOrder();
+  bool  NeedsReorder();
+  void  ReorderParticles();
+  float NeighbourIndexSpread();
+  template<typename T>
+  void  Permute(std::vector<T>& data, std::vector<T>& scratch);
   void  BuildNeighbours(float smoothingRadius);
   float CalculateLambda(size_t particleIdx, float smoothingRadius);
   float EstimateRestDensity(float smoothingRadius);
   bool  NeedsNeighbourRebuild();
+  float NeighbourListRadius(float smoothingRadius) const;
+  void  RefreshPairCache(float smoothingRadius);
+  void  SwapJacobiBuffers(std::vector<Vec3>& front, std::vector<Vec3>& back);
+  void  SyncPositionColumns();
+  void  SyncVelocityColumns();
+  SolverKernelConstants KernelConstants(float smoothingRadius) const;
+  SoAColumns PositionColumns() const { return {posX.data(), posY.data(), posZ.data()}; }
+  SoAColumns VelocityColumns() const { return {velX.data(), velY.data(), velZ.data()}; }
+  void  TuneSkinRadius(float smoothingRadius, double frameCostMs, bool rebuilt);
+  int   ProjectCollisions(Vec3* pos, Vec3* vel, SDFCollider* colliders, AppState* as);
+  float MaxPenetration(const SDFCollider* colliders);
+  // END_OF_STEP has no device version; on CUDA it runs as LAST_ITERATION
+  bool  CollideInIteration(int iter) const {
+    if (collisionSchedule == CollisionSchedule::EVERY_ITERATION)
+      return true;
+#ifndef USE_CUDA
+    if (collisionSchedule == CollisionSchedule::END_OF_STEP)
+      return false;
+#endif
+    return iter == numIterations - 1;
+  }
   void  TickTrickler(Vec3* positions, Vec3* predictedPositions, Vec3* velocities, Vec3* vorticities, float dt);
 };
 
@@ -133,6 +339,34 @@ inline int CellIndex(int cx, int cy, int cz, int numCells1D)
   return cx * numCells1D * numCells1D + cy * numCells1D + cz;
 }
 
+// Spread the low 10 bits of v so there are two zero bits between each
+DEVICE_CALLABLE
+inline unsigned int SpreadBits3(unsigned int v)
+{
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v <<  8)) & 0x0300f00f;
+  v = (v | (v <<  4)) & 0x030c30c3;
+  v = (v | (v <<  2)) & 0x09249249;
+  return v;
+}
+
+// Z-order (Morton) code of a cell, supports up to 1024 cells per axis
+DEVICE_CALLABLE
+inline unsigned int MortonCode(int cx, int cy, int cz)
+{
+  return (SpreadBits3(cx) << 2) | (SpreadBits3(cy) << 1) | SpreadBits3(cz);
+}
+
+DEVICE_CALLABLE
+inline float ScorrFromW(float W, float wdq, float scorr)
+{
+  float ratio = W / wdq;
+  float r2    = ratio  * ratio;
+  float r4    = r2 * r2;
+  return -scorr * r4;
+}
+
 DEVICE_CALLABLE
 inline float Scorr(Vec3 pi, Vec3 pj, float h2, float poly6, float wdq, float scorr)
 {
@@ -141,9 +375,5 @@ inline float Scorr(Vec3 pi, Vec3 pj, float h2, float poly6, float wdq, float sco
   if (d2 >= h2) return 0.0f;
 
   float sq    = h2 - d2;
-  float W     = poly6 * sq * sq * sq;
-  float ratio = W / wdq;
-  float r2    = ratio  * ratio;
-  float r4    = r2 * r2;
-  return -scorr * r4;
+  return ScorrFromW(poly6 * sq * sq * sq, wdq, scorr);
 }
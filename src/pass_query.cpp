@@ -0,0 +1,68 @@
+#include "pass_query.h"
+#include <GLFW/glfw3.h>
+
+// Not in the GL 3.3 loader; a plain query target when the driver has it
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+PassQuery::~PassQuery()
+{
+  if (timeQueries[0]) {
+    glDeleteQueries(PASS_QUERY_FRAMES, timeQueries);
+    glDeleteQueries(PASS_QUERY_FRAMES, sampleQueries);
+  }
+  if (invocationQueries[0])
+    glDeleteQueries(PASS_QUERY_FRAMES, invocationQueries);
+}
+
+bool PassQuery::Ready(GLuint query) const
+{
+  GLuint ready = 0;
+  glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &ready);
+  return ready != 0;
+}
+
+void PassQuery::Begin()
+{
+  if (!timeQueries[0]) {
+    glGenQueries(PASS_QUERY_FRAMES, timeQueries);
+    glGenQueries(PASS_QUERY_FRAMES, sampleQueries);
+    hasInvocations = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6) ||
+                     glfwExtensionSupported("GL_ARB_pipeline_statistics_query");
+    if (hasInvocations)
+      glGenQueries(PASS_QUERY_FRAMES, invocationQueries);
+  }
+  slot = (slot + 1) % PASS_QUERY_FRAMES;
+  active = false;
+  if (pending[slot]) {
+    if (!Ready(timeQueries[slot]) || !Ready(sampleQueries[slot]) ||
+        (hasInvocations && !Ready(invocationQueries[slot])))
+      return;
+    GLuint64 ns = 0, count = 0, shaded = 0;
+    glGetQueryObjectui64v(timeQueries[slot], GL_QUERY_RESULT, &ns);
+    glGetQueryObjectui64v(sampleQueries[slot], GL_QUERY_RESULT, &count);
+    if (hasInvocations)
+      glGetQueryObjectui64v(invocationQueries[slot], GL_QUERY_RESULT, &shaded);
+    milliseconds = ns / 1e6;
+    samples      = count;
+    invocations  = shaded;
+    pending[slot] = false;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, timeQueries[slot]);
+  glBeginQuery(GL_SAMPLES_PASSED, sampleQueries[slot]);
+  if (hasInvocations)
+    glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, invocationQueries[slot]);
+  active = true;
+}
+
+void PassQuery::End()
+{
+  if (!active) return;
+  if (hasInvocations)
+    glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+  glEndQuery(GL_SAMPLES_PASSED);
+  glEndQuery(GL_TIME_ELAPSED);
+  pending[slot] = true;
+  active = false;
+}
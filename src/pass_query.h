@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <glad/glad.h>
+
+constexpr int PASS_QUERY_FRAMES = 3;   // queries in flight
+
+// GPU time and fragment counts for one render pass. Samples passed counts
+// the fragments that survived the depth test, which early-Z does not change;
+// fragment shader invocations (GL_ARB_pipeline_statistics_query, core in
+// 4.6) count the fragments shaded, which it does. Results are read back a
+// few frames late, when the driver has them, so the CPU never waits on the
+// GPU.
+class PassQuery {
+public:
+  PassQuery() = default;
+  ~PassQuery();
+  PassQuery(const PassQuery&) = delete;
+  PassQuery& operator=(const PassQuery&) = delete;
+
+  // Around the draws of the pass; skipped while the next slot is still in flight
+  void Begin();
+  void End();
+
+  // Newest finished results
+  double   Milliseconds() const { return milliseconds; }
+  uint64_t Samples() const { return samples; }
+  // Fragment shader invocations; 0 unless HasInvocations()
+  uint64_t Invocations() const { return invocations; }
+  bool     HasInvocations() const { return hasInvocations; }
+
+private:
+  bool Ready(GLuint query) const;
+
+  GLuint timeQueries[PASS_QUERY_FRAMES]       = {};
+  GLuint sampleQueries[PASS_QUERY_FRAMES]     = {};
+  GLuint invocationQueries[PASS_QUERY_FRAMES] = {};
+  bool   pending[PASS_QUERY_FRAMES]           = {};
+  int    slot    = 0;
+  bool   active  = false;
+  bool   hasInvocations = false;
+  double   milliseconds = 0.0;
+  uint64_t samples      = 0;
+  uint64_t invocations  = 0;
+};
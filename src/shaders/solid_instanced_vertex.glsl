@@ -0,0 +1,24 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+// per instance (ObjectInstance)
+layout(location = 3) in mat4 aModel;    // locations 3-6
+layout(location = 7) in vec4 aColor;
+
+uniform mat4 uView;
+uniform mat4 uProjection;
+
+out vec3 vNormalWorld;
+out vec4 vColor;
+out vec3 vFragPos;
+
+// solid_vertex.glsl with the model matrix and colour per instance
+void main()
+{
+  vec4 world   = aModel * vec4(aPos, 1.0);
+  vFragPos     = world.xyz;
+  vNormalWorld = normalize(aNormal);
+  vColor       = aColor;
+  gl_Position  = uProjection * uView * world;
+}
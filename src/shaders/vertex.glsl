@@ -1,8 +1,9 @@
 #version 330 core
 
 layout (location=0) in vec3 vertexPos;
-layout (location=1) in vec3 instancePos;
-layout (location=2) in vec3 instanceVel;
+// xyz: position over [-1, 1], w: speed over [0, INSTANCE_MAX_SPEED], both as
+// normalized 16-bit (PackedInstance)
+layout (location=1) in vec4 instanceData;
 
 out vec3 vColor;
 out vec2 uv;
@@ -11,7 +12,6 @@ uniform mat4 projection;
 uniform mat4 view;
 uniform float radius;
 
-const float MAX_SPEED = 3.0;
 const vec3 c0 = vec3(117.0/255.0, 14.0/255.0,  227.0/255.0); // purple
 const vec3 c1 = vec3( 80.0/255.0, 199.0/255.0, 187.0/255.0); // teal
 const vec3 c2 = vec3(230.0/255.0, 213.0/255.0,  25.0/255.0); // yellow
@@ -24,11 +24,11 @@ vec3 velocityColor(float s) {
 }
 
 void main(){
+    vec3 instancePos = instanceData.xyz * 2.0 - 1.0;
     vec4 viewPos = view * vec4(instancePos, 1.0);
     viewPos.xy += vertexPos.xy * radius;
     gl_Position = projection * viewPos;
     uv = vertexPos.xy;
 
-    float speed = clamp(length(instanceVel) / MAX_SPEED, 0.0, 1.0);
-    vColor = velocityColor(speed);
+    vColor = velocityColor(instanceData.w);
 }
@@ -0,0 +1,180 @@
+#include "sim_thread.h"
+#include "objects3d/sdf_volume.h"
+
+#include <chrono>
+#include <cstring>
+
+using SimClock = std::chrono::steady_clock;
+
+SimThread::SimThread(Particles& particles, const SDFCollider* initialColliders,
+                     size_t numColliders, AppState* as)
+  : particles(particles), appState(as),
+    colliders(initialColliders, initialColliders + numColliders)
+{
+  Publish();
+}
+
+SimThread::~SimThread()
+{
+  Stop();
+}
+
+void SimThread::Start()
+{
+#ifndef USE_CUDA
+  if (Threaded()) return;
+  stopping = false;
+  worker = std::thread(&SimThread::Loop, this);
+#endif
+}
+
+void SimThread::Stop()
+{
+  if (!Threaded()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+void SimThread::Post(SimCommand command)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    commands.push_back(std::move(command));
+  }
+  wake.notify_one();
+}
+
+void SimThread::SetInputs(const SimInputs& newInputs)
+{
+  bool resumed;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    resumed = newInputs.running && !inputs.running;
+    inputs  = newInputs;
+  }
+  if (resumed)
+    wake.notify_one();
+}
+
+void SimThread::RequestStep()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++pendingSteps;
+  }
+  wake.notify_one();
+}
+
+void SimThread::Tick(float dt)
+{
+  std::vector<SimCommand> pending;
+  SimInputs current;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.swap(commands);
+    current = inputs;
+    pendingSteps = 0;
+  }
+  Apply(pending);
+  if (dt > 0.0f)
+    Step(dt, current);
+  if (dt > 0.0f || !pending.empty())
+    Publish();
+}
+
+void SimThread::Loop()
+{
+  std::vector<SimCommand> pending;
+  SimClock::time_point last = SimClock::now();
+  for (;;) {
+    SimInputs current;
+    bool explicitStep = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] {
+        return stopping || inputs.running || pendingSteps > 0 || !commands.empty();
+      });
+      if (stopping) return;
+      pending.swap(commands);
+      current = inputs;
+      if (current.running) {
+        pendingSteps = 0;
+      } else if (pendingSteps > 0) {
+        --pendingSteps;
+        explicitStep = true;
+      }
+    }
+    Apply(pending);
+
+    float dt = 0.0f;
+    if (current.running) {
+      // step with wall time like the old render-locked loop did, but no
+      // finer than SIM_MIN_DT so a cheap scene does not spin on tiny steps
+      SimClock::time_point now = SimClock::now();
+      float elapsed = std::chrono::duration<float>(now - last).count();
+      if (elapsed < SIM_MIN_DT) {
+        std::this_thread::sleep_for(std::chrono::duration<float>(SIM_MIN_DT - elapsed));
+        now = SimClock::now();
+        elapsed = std::chrono::duration<float>(now - last).count();
+      }
+      last = now;
+      dt = std::min(elapsed, 1.0f / 60.0f);
+    } else {
+      last = SimClock::now();
+      if (explicitStep)
+        dt = 1.0f / 60.0f;
+    }
+
+    if (dt > 0.0f)
+      Step(dt, current);
+    if (dt > 0.0f || !pending.empty())
+      Publish();
+    pending.clear();
+  }
+}
+
+void SimThread::Apply(std::vector<SimCommand>& pending)
+{
+  for (SimCommand& command : pending)
+    command(particles, colliders);
+}
+
+void SimThread::Step(float dt, const SimInputs& in)
+{
+  SimClock::time_point start = SimClock::now();
+  particles.Update(dt, smoothingRadius, in.radiusPx, in.screenWidth, in.screenHeight,
+                   in.mouseOrigin, in.mouseDirection, in.mouseStrength, colliders.data(), (int)colliders.size(), appState);
+  lastStepMs = std::chrono::duration<float, std::milli>(SimClock::now() - start).count();
+  ++stepCount;
+}
+
+void SimThread::Publish()
+{
+  SimSnapshot& snap = snapshots.WriteBuffer();
+  snap.numParticles    = particles.numParticles;
+  snap.activeParticles = particles.activeParticles;
+  snap.step            = stepCount;
+  snap.stepMs          = lastStepMs;
+#ifndef USE_CUDA
+  const int n = particles.activeParticles;
+  // the renderer only needs the packed form, so this is the one pass
+  // over the step's final state instead of copying both arrays
+  snap.instances.resize(n);
+  particles.PackInstances(snap.instances.data(), snap.instanceCells);
+  snap.instanceCellSize = smoothingRadius;
+  snap.neighbourBytes     = particles.NeighbourMemoryBytes();
+  snap.neighbourPairs     = particles.neighbourStart.empty() ? 0 : particles.neighbourStart.back();
+  snap.pairCacheBytes     = particles.PairCacheBytes();
+  snap.skinRadius         = particles.skinRadius;
+  snap.rebuildRate        = particles.rebuildRate;
+  snap.activeKernelFamily = particles.activeKernelFamily;
+  snap.sdfVolumeBytes     = SDFVolumeBytes();
+  snap.sdfVolumeError     = SDFVolumeMaxError();
+  snap.collisionSkipRate  = particles.collisionSkipRate;
+#endif
+  snapshots.Publish();
+}
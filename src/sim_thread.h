@@ -0,0 +1,94 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "particles.h"
+#include "triple_buffer.h"
+
+// Per-frame inputs from the window thread; the newest set wins
+struct SimInputs {
+  bool  running = false;       // false: paused, only RequestStep() advances
+  float radiusPx = 0.0f;
+  int   screenWidth = 0;
+  int   screenHeight = 0;
+  Vec3  mouseOrigin{0.0f, 0.0f, 0.0f};
+  Vec3  mouseDirection{0.0f, 0.0f, 0.0f};
+  float mouseStrength = 0.0f;
+};
+
+// Everything the renderer and HUD read from the simulation
+struct SimSnapshot {
+  std::vector<PackedInstance> instances;   // first activeParticles only (empty on CUDA)
+  std::vector<InstanceCell>   instanceCells;  // runs of instances per grid cell, may be empty
+  float    instanceCellSize = 0.0f;          // width of those cells
+  int      numParticles    = 0;
+  int      activeParticles = 0;
+  uint64_t step            = 0;
+  float    stepMs          = 0.0f;
+
+  size_t   neighbourBytes  = 0;
+  int      neighbourPairs  = 0;
+  size_t   pairCacheBytes  = 0;
+  float    skinRadius      = 0.0f;
+  float    rebuildRate     = 0.0f;
+  size_t   sdfVolumeBytes  = 0;
+  float    sdfVolumeError  = 0.0f;
+  float    collisionSkipRate = 0.0f;
+  KernelFamily activeKernelFamily = KernelFamily::SCALAR;
+};
+
+// Work for the simulation, run between two steps on the thread that owns it
+using SimCommand = std::function<void(Particles& particles, std::vector<SDFCollider>& colliders)>;
+
+// Owns the Particles once started. With Start() the solver runs on its own
+// thread and publishes a snapshot after every step; otherwise Tick() steps
+// on the caller (CUDA builds, where the device buffers belong to the GL
+// thread). Either way other threads only talk to it through Post(),
+// SetInputs() and RequestStep().
+class SimThread {
+public:
+  SimThread(Particles& particles, const SDFCollider* colliders, size_t numColliders, AppState* as);
+  ~SimThread();
+  SimThread(const SimThread&) = delete;
+  SimThread& operator=(const SimThread&) = delete;
+
+  void Start();
+  void Stop();
+  bool Threaded() const { return worker.joinable(); }
+
+  void Post(SimCommand command);
+  void SetInputs(const SimInputs& inputs);
+  void RequestStep();
+
+  // Unthreaded only: apply queued commands and advance by dt (0 = no step)
+  void Tick(float dt);
+
+  // Newest complete snapshot; call from the render thread only
+  const SimSnapshot& Latest() { return snapshots.Read(); }
+
+private:
+  void Loop();
+  void Apply(std::vector<SimCommand>& commands);
+  void Step(float dt, const SimInputs& inputs);
+  void Publish();
+
+  Particles&  particles;
+  AppState*   appState;
+  std::vector<SDFCollider> colliders;
+  uint64_t    stepCount = 0;
+  float       lastStepMs = 0.0f;
+
+  std::thread             worker;
+  std::mutex              mutex;          // guards everything below
+  std::condition_variable wake;
+  std::vector<SimCommand> commands;
+  SimInputs               inputs;
+  int                     pendingSteps = 0;
+  bool                    stopping = false;
+
+  TripleBuffer<SimSnapshot> snapshots;
+};
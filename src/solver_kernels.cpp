@@ -0,0 +1,101 @@
+#include "solver_kernels.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// CPU feature detection. Checks both the instruction set and that the OS
+// saves the wider registers on context switch.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+static bool CpuHasAvx2()
+{
+  int regs[4];
+  __cpuid(regs, 1);
+  bool osxsave = (regs[2] & (1 << 27)) != 0;
+  bool fma     = (regs[2] & (1 << 12)) != 0;
+  if (!osxsave || !fma || (_xgetbv(0) & 0x6) != 0x6) return false;
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+}
+
+static bool CpuHasAvx512()
+{
+  if (!CpuHasAvx2() || (_xgetbv(0) & 0xE6) != 0xE6) return false;
+  int regs[4];
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 16)) != 0;
+}
+#elif defined(__x86_64__) || defined(__i386__)
+static bool CpuHasAvx2()
+{
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static bool CpuHasAvx512()
+{
+  return CpuHasAvx2() && __builtin_cpu_supports("avx512f");
+}
+#else
+static bool CpuHasAvx2()   { return false; }
+static bool CpuHasAvx512() { return false; }
+#endif
+
+bool CpuSupports(KernelFamily family)
+{
+  static const bool avx2   = CpuHasAvx2()   && Avx2SolverKernels()   != nullptr;
+  static const bool avx512 = CpuHasAvx512() && Avx512SolverKernels() != nullptr;
+
+  switch (family) {
+  case KernelFamily::AVX2:   return avx2;
+  case KernelFamily::AVX512: return avx512;
+  default:                   return true;
+  }
+}
+
+KernelFamily ResolveKernelFamily(KernelFamily requested)
+{
+  if (requested == KernelFamily::AUTO || requested == KernelFamily::AVX512) {
+    if (CpuSupports(KernelFamily::AVX512)) return KernelFamily::AVX512;
+    requested = KernelFamily::AVX2;
+  }
+  if (requested == KernelFamily::AVX2 && CpuSupports(KernelFamily::AVX2))
+    return KernelFamily::AVX2;
+  return KernelFamily::SCALAR;
+}
+
+const SolverKernels* GetSolverKernels(KernelFamily family)
+{
+  switch (family) {
+  case KernelFamily::AVX2:   return Avx2SolverKernels();
+  case KernelFamily::AVX512: return Avx512SolverKernels();
+  default:                   return nullptr;
+  }
+}
+
+const char* KernelFamilyName(KernelFamily family)
+{
+  switch (family) {
+  case KernelFamily::AUTO:   return "auto";
+  case KernelFamily::SCALAR: return "scalar";
+  case KernelFamily::AVX2:   return "avx2";
+  case KernelFamily::AVX512: return "avx512";
+  }
+  return "unknown";
+}
+
+bool ParseKernelFamily(const char* name, KernelFamily& family)
+{
+  const KernelFamily all[] = {KernelFamily::AUTO, KernelFamily::SCALAR,
+                              KernelFamily::AVX2, KernelFamily::AVX512};
+  for (KernelFamily f : all) {
+    if (std::strcmp(name, KernelFamilyName(f)) == 0) {
+      family = f;
+      return true;
+    }
+  }
+  return false;
+}
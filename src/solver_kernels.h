@@ -0,0 +1,72 @@
+#pragma once
+
+// Hand-vectorised neighbour loops for the CPU solver. Each instruction set is
+// built in its own translation unit with the matching compiler flags (see
+// CMakeLists.txt) and picked at runtime, so one binary runs on any x86 CPU.
+//
+// This header is included by those translation units, so it must stay free of
+// inline functions shared with the rest of the program: the linker is free to
+// keep any one copy of an inline function, and an AVX-512 copy would then run
+// on every CPU.
+
+#include <cstdint>
+
+enum class KernelFamily { AUTO, SCALAR, AVX2, AVX512 };
+
+// Structure-of-arrays view of a Vec3 field
+struct SoAColumns {
+  const float* x;
+  const float* y;
+  const float* z;
+};
+
+struct KernelVec { float x, y, z; };
+
+struct SolverKernelConstants {
+  float h, h2;
+  float poly6, spiky;
+  float wDq, scorrCoefficient;
+  float restDensity, relaxation;
+  float selfDensity;               // poly6 * h^6
+};
+
+// All kernels sum over neighbours [begin, end) of particle i, skipping i
+// itself and anything outside h, exactly like the scalar loops in particles.cpp
+struct SolverKernels {
+  float     (*lambda)(int i, const int* neighbours, int begin, int end,
+                      SoAColumns pos, const SolverKernelConstants& c);
+  // Unscaled position correction; the caller divides by the rest density
+  KernelVec (*delta)(int i, const int* neighbours, int begin, int end,
+                     SoAColumns pos, const float* lambdas,
+                     const SolverKernelConstants& c);
+  void      (*xsph)(int i, const int* neighbours, int begin, int end,
+                    SoAColumns pos, SoAColumns vel,
+                    const SolverKernelConstants& c, KernelVec& sum, float& wSum);
+  // Vorticity (curl of velocity)
+  KernelVec (*curl)(int i, const int* neighbours, int begin, int end,
+                    SoAColumns pos, SoAColumns vel, const SolverKernelConstants& c);
+  // Vorticity location vector: sum of gradW * |omega_j|
+  KernelVec (*eta)(int i, const int* neighbours, int begin, int end,
+                   SoAColumns pos, const float* omegaMag,
+                   const SolverKernelConstants& c);
+  // Render instances [begin, end) from the AoS Vec3 arrays: instance k is
+  // particle order[k] (k itself without order), four uint16_t at out + 4 * k,
+  // as PackInstance() in packed_instance.h (within one step where FMA
+  // contraction rounds apart)
+  void      (*pack)(const float* positions, const float* velocities, const int* order,
+                    int begin, int end, float invMaxSpeed, uint16_t* out);
+};
+
+// Kernel tables, nullptr when the family was not compiled in
+const SolverKernels* Avx2SolverKernels();
+const SolverKernels* Avx512SolverKernels();
+
+bool         CpuSupports(KernelFamily family);
+// AUTO becomes the widest family this CPU and build support; an unsupported
+// request falls back to the next narrower one
+KernelFamily ResolveKernelFamily(KernelFamily requested);
+// nullptr for SCALAR, which runs the loops in particles.cpp
+const SolverKernels* GetSolverKernels(KernelFamily family);
+
+const char*  KernelFamilyName(KernelFamily family);
+bool         ParseKernelFamily(const char* name, KernelFamily& family);
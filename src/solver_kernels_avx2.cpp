@@ -0,0 +1,66 @@
+// Built with -mavx2 -mfma (/arch:AVX2 on MSVC); only entered after
+// CpuSupports(KernelFamily::AVX2) has been checked.
+#include "solver_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+  static constexpr int W = 8;
+  using F = __m256;
+  using I = __m256i;
+  using M = __m256;   // all-ones lanes are active
+
+  static F Set(float v)       { return _mm256_set1_ps(v); }
+  static F Zero()             { return _mm256_setzero_ps(); }
+  static F Add(F a, F b)      { return _mm256_add_ps(a, b); }
+  static F Sub(F a, F b)      { return _mm256_sub_ps(a, b); }
+  static F Mul(F a, F b)      { return _mm256_mul_ps(a, b); }
+  static F Div(F a, F b)      { return _mm256_div_ps(a, b); }
+  static F Sqrt(F a)          { return _mm256_sqrt_ps(a); }
+  static F Min(F a, F b)      { return _mm256_min_ps(a, b); }
+  static F Max(F a, F b)      { return _mm256_max_ps(a, b); }
+
+  static M TailMask(int n) {
+    const I lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(n), lane));
+  }
+  static I LoadIndices(const int* p, M m) {
+    return _mm256_maskload_epi32(p, _mm256_castps_si256(m));
+  }
+  static F Gather(const float* base, I idx, M m) {
+    return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, idx, m, 4);
+  }
+  static M NotEqual(I idx, int i) {
+    return _mm256_castsi256_ps(_mm256_xor_si256(
+        _mm256_cmpeq_epi32(idx, _mm256_set1_epi32(i)), _mm256_set1_epi32(-1)));
+  }
+  static M Less(F a, F b)      { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static M GreaterEq(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+  static M And(M a, M b)       { return _mm256_and_ps(a, b); }
+  static F AddMasked(F acc, M m, F v) { return _mm256_add_ps(acc, _mm256_and_ps(m, v)); }
+
+  static float Sum(F v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+  }
+  static void StoreTruncated(int* p, F v) {
+    _mm256_storeu_si256((__m256i*)p, _mm256_cvttps_epi32(v));
+  }
+};
+
+#include "solver_kernels_simd.inl"
+
+} // namespace
+
+const SolverKernels* Avx2SolverKernels() { return MakeSolverKernels<Avx2>(); }
+
+#else
+
+const SolverKernels* Avx2SolverKernels() { return nullptr; }
+
+#endif
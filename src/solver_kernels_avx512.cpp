@@ -0,0 +1,54 @@
+// Built with -mavx512f -mfma (/arch:AVX512 on MSVC); only entered after
+// CpuSupports(KernelFamily::AVX512) has been checked.
+#include "solver_kernels.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512 {
+  static constexpr int W = 16;
+  using F = __m512;
+  using I = __m512i;
+  using M = __mmask16;
+
+  static F Set(float v)       { return _mm512_set1_ps(v); }
+  static F Zero()             { return _mm512_setzero_ps(); }
+  static F Add(F a, F b)      { return _mm512_add_ps(a, b); }
+  static F Sub(F a, F b)      { return _mm512_sub_ps(a, b); }
+  static F Mul(F a, F b)      { return _mm512_mul_ps(a, b); }
+  static F Div(F a, F b)      { return _mm512_div_ps(a, b); }
+  static F Sqrt(F a)          { return _mm512_sqrt_ps(a); }
+  static F Min(F a, F b)      { return _mm512_min_ps(a, b); }
+  static F Max(F a, F b)      { return _mm512_max_ps(a, b); }
+
+  static M TailMask(int n) {
+    return n >= W ? (M)0xFFFF : (M)((1u << n) - 1u);
+  }
+  static I LoadIndices(const int* p, M m) { return _mm512_maskz_loadu_epi32(m, p); }
+  static F Gather(const float* base, I idx, M m) {
+    return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, idx, base, 4);
+  }
+  static M NotEqual(I idx, int i) {
+    return _mm512_cmpneq_epi32_mask(idx, _mm512_set1_epi32(i));
+  }
+  static M Less(F a, F b)      { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+  static M GreaterEq(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+  static M And(M a, M b)       { return (M)(a & b); }
+  static F AddMasked(F acc, M m, F v) { return _mm512_mask_add_ps(acc, m, acc, v); }
+  static float Sum(F v)        { return _mm512_reduce_add_ps(v); }
+  static void StoreTruncated(int* p, F v) { _mm512_storeu_si512(p, _mm512_cvttps_epi32(v)); }
+};
+
+#include "solver_kernels_simd.inl"
+
+} // namespace
+
+const SolverKernels* Avx512SolverKernels() { return MakeSolverKernels<Avx512>(); }
+
+#else
+
+const SolverKernels* Avx512SolverKernels() { return nullptr; }
+
+#endif
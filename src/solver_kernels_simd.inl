@@ -0,0 +1,245 @@
+// Kernel bodies shared by the AVX2 and AVX-512 translation units. Included
+// inside an anonymous namespace after the file defines its lane wrapper S:
+//
+//   W                     lanes per vector
+//   F, I, M               float vector, int vector, lane mask
+//   Set, Zero, Add, Sub, Mul, Div, Sqrt, Min, Max
+//   TailMask(n)           first min(n, W) lanes
+//   LoadIndices(p, m)     masked load of W neighbour indices
+//   Gather(base, idx, m)  base[idx] in active lanes, 0 elsewhere
+//   NotEqual(idx, i), Less(a, b), GreaterEq(a, b), And(a, b)
+//   AddMasked(acc, m, v)  acc + v in active lanes
+//   Sum(v)                horizontal sum
+//   StoreTruncated(p, v)  W ints, v rounded toward zero
+//
+// Inactive lanes may hold inf/NaN (division by a zero distance); they are
+// dropped by the masked accumulation and never reach a result.
+
+template<typename S>
+struct PairTerms {
+  typename S::M m;
+  typename S::I idx;
+  typename S::F dx, dy, dz, d2;
+};
+
+// Loads one vector of neighbours and their offsets p_i - p_j
+template<typename S>
+inline PairTerms<S> LoadPairs(int i, const int* neighbours, int k, int end,
+                              SoAColumns pos, typename S::F xi,
+                              typename S::F yi, typename S::F zi)
+{
+  PairTerms<S> p;
+  p.m   = S::TailMask(end - k);
+  p.idx = S::LoadIndices(neighbours + k, p.m);
+  p.m   = S::And(p.m, S::NotEqual(p.idx, i));
+  p.dx  = S::Sub(xi, S::Gather(pos.x, p.idx, p.m));
+  p.dy  = S::Sub(yi, S::Gather(pos.y, p.idx, p.m));
+  p.dz  = S::Sub(zi, S::Gather(pos.z, p.idx, p.m));
+  p.d2  = S::Add(S::Add(S::Mul(p.dx, p.dx), S::Mul(p.dy, p.dy)), S::Mul(p.dz, p.dz));
+  return p;
+}
+
+template<typename S>
+inline typename S::F Poly6(typename S::F d2, typename S::F h2, typename S::F poly6)
+{
+  typename S::F sq = S::Sub(h2, d2);
+  return S::Mul(poly6, S::Mul(S::Mul(sq, sq), sq));
+}
+
+// (h - d)^2 / d, the spiky gradient without its constant
+template<typename S>
+inline typename S::F SpikyScalar(typename S::F d2, typename S::F h)
+{
+  typename S::F d = S::Sqrt(d2);
+  typename S::F t = S::Sub(h, d);
+  return S::Div(S::Mul(t, t), d);
+}
+
+template<typename S>
+float LambdaKernel(int i, const int* neighbours, int begin, int end,
+                   SoAColumns pos, const SolverKernelConstants& c)
+{
+  using F = typename S::F;
+  const F xi = S::Set(pos.x[i]), yi = S::Set(pos.y[i]), zi = S::Set(pos.z[i]);
+  const F h  = S::Set(c.h), h2 = S::Set(c.h2), eps = S::Set(1e-12f);
+  const F poly6     = S::Set(c.poly6);
+  const F gradScale = S::Set(c.spiky / c.restDensity);
+
+  F density = S::Zero(), gx = S::Zero(), gy = S::Zero(), gz = S::Zero();
+  F gradSq  = S::Zero();
+  for (int k = begin; k < end; k += S::W) {
+    PairTerms<S> p = LoadPairs<S>(i, neighbours, k, end, pos, xi, yi, zi);
+    auto m = S::And(p.m, S::And(S::Less(p.d2, h2), S::GreaterEq(p.d2, eps)));
+
+    F s  = S::Mul(gradScale, SpikyScalar<S>(p.d2, h));
+    F ax = S::Mul(p.dx, s), ay = S::Mul(p.dy, s), az = S::Mul(p.dz, s);
+    density = S::AddMasked(density, m, Poly6<S>(p.d2, h2, poly6));
+    gx      = S::AddMasked(gx, m, ax);
+    gy      = S::AddMasked(gy, m, ay);
+    gz      = S::AddMasked(gz, m, az);
+    gradSq  = S::AddMasked(gradSq, m,
+                           S::Add(S::Add(S::Mul(ax, ax), S::Mul(ay, ay)), S::Mul(az, az)));
+  }
+
+  float rho = c.selfDensity + S::Sum(density);
+  float sx = S::Sum(gx), sy = S::Sum(gy), sz = S::Sum(gz);
+  float denominator = S::Sum(gradSq) + sx * sx + sy * sy + sz * sz;
+  float Ci = (rho / c.restDensity) - 1.0f;
+  return -Ci / (denominator + c.relaxation);
+}
+
+template<typename S>
+KernelVec DeltaKernel(int i, const int* neighbours, int begin, int end,
+                      SoAColumns pos, const float* lambdas,
+                      const SolverKernelConstants& c)
+{
+  using F = typename S::F;
+  const F xi = S::Set(pos.x[i]), yi = S::Set(pos.y[i]), zi = S::Set(pos.z[i]);
+  const F h  = S::Set(c.h), h2 = S::Set(c.h2), eps = S::Set(1e-12f);
+  const F poly6    = S::Set(c.poly6), spiky = S::Set(c.spiky);
+  const F invWDq   = S::Set(1.0f / c.wDq);
+  const F negScorr = S::Set(-c.scorrCoefficient);
+  const F lambdaI  = S::Set(lambdas[i]);
+
+  F sx = S::Zero(), sy = S::Zero(), sz = S::Zero();
+  for (int k = begin; k < end; k += S::W) {
+    PairTerms<S> p = LoadPairs<S>(i, neighbours, k, end, pos, xi, yi, zi);
+    auto m = S::And(p.m, S::And(S::Less(p.d2, h2), S::GreaterEq(p.d2, eps)));
+
+    F ratio = S::Mul(Poly6<S>(p.d2, h2, poly6), invWDq);
+    F r2    = S::Mul(ratio, ratio);
+    F corr  = S::Mul(negScorr, S::Mul(r2, r2));
+    F lambdaSum = S::Add(S::Add(lambdaI, S::Gather(lambdas, p.idx, m)), corr);
+    F f     = S::Mul(S::Mul(spiky, SpikyScalar<S>(p.d2, h)), lambdaSum);
+    sx = S::AddMasked(sx, m, S::Mul(p.dx, f));
+    sy = S::AddMasked(sy, m, S::Mul(p.dy, f));
+    sz = S::AddMasked(sz, m, S::Mul(p.dz, f));
+  }
+  return KernelVec{S::Sum(sx), S::Sum(sy), S::Sum(sz)};
+}
+
+template<typename S>
+void XsphKernel(int i, const int* neighbours, int begin, int end,
+                SoAColumns pos, SoAColumns vel, const SolverKernelConstants& c,
+                KernelVec& sum, float& wSum)
+{
+  using F = typename S::F;
+  const F xi  = S::Set(pos.x[i]), yi = S::Set(pos.y[i]), zi = S::Set(pos.z[i]);
+  const F vxi = S::Set(vel.x[i]), vyi = S::Set(vel.y[i]), vzi = S::Set(vel.z[i]);
+  const F h2  = S::Set(c.h2), poly6 = S::Set(c.poly6);
+
+  F sx = S::Zero(), sy = S::Zero(), sz = S::Zero(), ws = S::Zero();
+  for (int k = begin; k < end; k += S::W) {
+    PairTerms<S> p = LoadPairs<S>(i, neighbours, k, end, pos, xi, yi, zi);
+    auto m = S::And(p.m, S::Less(p.d2, h2));
+
+    F w = Poly6<S>(p.d2, h2, poly6);
+    sx = S::AddMasked(sx, m, S::Mul(S::Sub(S::Gather(vel.x, p.idx, m), vxi), w));
+    sy = S::AddMasked(sy, m, S::Mul(S::Sub(S::Gather(vel.y, p.idx, m), vyi), w));
+    sz = S::AddMasked(sz, m, S::Mul(S::Sub(S::Gather(vel.z, p.idx, m), vzi), w));
+    ws = S::AddMasked(ws, m, w);
+  }
+  sum  = KernelVec{S::Sum(sx), S::Sum(sy), S::Sum(sz)};
+  wSum = S::Sum(ws);
+}
+
+template<typename S>
+KernelVec CurlKernel(int i, const int* neighbours, int begin, int end,
+                     SoAColumns pos, SoAColumns vel, const SolverKernelConstants& c)
+{
+  using F = typename S::F;
+  const F xi  = S::Set(pos.x[i]), yi = S::Set(pos.y[i]), zi = S::Set(pos.z[i]);
+  const F vxi = S::Set(vel.x[i]), vyi = S::Set(vel.y[i]), vzi = S::Set(vel.z[i]);
+  const F h   = S::Set(c.h), h2 = S::Set(c.h2), eps = S::Set(1e-12f);
+
+  F ox = S::Zero(), oy = S::Zero(), oz = S::Zero();
+  for (int k = begin; k < end; k += S::W) {
+    PairTerms<S> p = LoadPairs<S>(i, neighbours, k, end, pos, xi, yi, zi);
+    auto m = S::And(p.m, S::And(S::Less(p.d2, h2), S::GreaterEq(p.d2, eps)));
+
+    F s  = SpikyScalar<S>(p.d2, h);
+    F gx = S::Mul(p.dx, s), gy = S::Mul(p.dy, s), gz = S::Mul(p.dz, s);
+    F vx = S::Sub(S::Gather(vel.x, p.idx, m), vxi);
+    F vy = S::Sub(S::Gather(vel.y, p.idx, m), vyi);
+    F vz = S::Sub(S::Gather(vel.z, p.idx, m), vzi);
+    ox = S::AddMasked(ox, m, S::Sub(S::Mul(vy, gz), S::Mul(vz, gy)));
+    oy = S::AddMasked(oy, m, S::Sub(S::Mul(vz, gx), S::Mul(vx, gz)));
+    oz = S::AddMasked(oz, m, S::Sub(S::Mul(vx, gy), S::Mul(vy, gx)));
+  }
+  return KernelVec{S::Sum(ox), S::Sum(oy), S::Sum(oz)};
+}
+
+template<typename S>
+KernelVec EtaKernel(int i, const int* neighbours, int begin, int end,
+                    SoAColumns pos, const float* omegaMag,
+                    const SolverKernelConstants& c)
+{
+  using F = typename S::F;
+  const F xi = S::Set(pos.x[i]), yi = S::Set(pos.y[i]), zi = S::Set(pos.z[i]);
+  const F h  = S::Set(c.h), h2 = S::Set(c.h2), eps = S::Set(1e-12f);
+
+  F ex = S::Zero(), ey = S::Zero(), ez = S::Zero();
+  for (int k = begin; k < end; k += S::W) {
+    PairTerms<S> p = LoadPairs<S>(i, neighbours, k, end, pos, xi, yi, zi);
+    auto m = S::And(p.m, S::And(S::Less(p.d2, h2), S::GreaterEq(p.d2, eps)));
+
+    F s = S::Mul(SpikyScalar<S>(p.d2, h), S::Gather(omegaMag, p.idx, m));
+    ex = S::AddMasked(ex, m, S::Mul(p.dx, s));
+    ey = S::AddMasked(ey, m, S::Mul(p.dy, s));
+    ez = S::AddMasked(ez, m, S::Mul(p.dz, s));
+  }
+  return KernelVec{S::Sum(ex), S::Sum(ey), S::Sum(ez)};
+}
+
+// Quantises one vector of [0, 1] values to 16 bits; NaN lands on 0
+template<typename S>
+inline typename S::F QuantiseLanes(typename S::F t)
+{
+  t = S::Min(S::Max(t, S::Zero()), S::Set(1.0f));
+  return S::Add(S::Mul(t, S::Set(65535.0f)), S::Set(0.5f));
+}
+
+template<typename S>
+void PackKernel(const float* positions, const float* velocities, const int* order,
+                int begin, int end, float invMaxSpeed, uint16_t* out)
+{
+  using F = typename S::F;
+  const F one = S::Set(1.0f), half = S::Set(0.5f), invMax = S::Set(invMaxSpeed);
+  int offsets[S::W];
+  int q[4][S::W];
+  for (int k = begin; k < end; k += S::W) {
+    auto m = S::TailMask(end - k);
+    const int n = end - k < S::W ? end - k : S::W;
+    for (int l = 0; l < n; ++l)
+      offsets[l] = 3 * (order ? order[k + l] : k + l);
+    auto idx = S::LoadIndices(offsets, m);
+
+    F vx = S::Gather(velocities, idx, m);
+    F vy = S::Gather(velocities + 1, idx, m);
+    F vz = S::Gather(velocities + 2, idx, m);
+    F speed = S::Sqrt(S::Add(S::Add(S::Mul(vx, vx), S::Mul(vy, vy)), S::Mul(vz, vz)));
+    S::StoreTruncated(q[0], QuantiseLanes<S>(S::Mul(S::Add(S::Gather(positions, idx, m), one), half)));
+    S::StoreTruncated(q[1], QuantiseLanes<S>(S::Mul(S::Add(S::Gather(positions + 1, idx, m), one), half)));
+    S::StoreTruncated(q[2], QuantiseLanes<S>(S::Mul(S::Add(S::Gather(positions + 2, idx, m), one), half)));
+    S::StoreTruncated(q[3], QuantiseLanes<S>(S::Mul(speed, invMax)));
+
+    // interleave into x, y, z, speed
+    uint16_t* o = out + 4 * k;
+    for (int l = 0; l < n; ++l) {
+      o[4 * l + 0] = (uint16_t)q[0][l];
+      o[4 * l + 1] = (uint16_t)q[1][l];
+      o[4 * l + 2] = (uint16_t)q[2][l];
+      o[4 * l + 3] = (uint16_t)q[3][l];
+    }
+  }
+}
+
+template<typename S>
+const SolverKernels* MakeSolverKernels()
+{
+  static const SolverKernels kernels = {
+    LambdaKernel<S>, DeltaKernel<S>, XsphKernel<S>, CurlKernel<S>, EtaKernel<S>,
+    PackKernel<S>
+  };
+  return &kernels;
+}
@@ -1,11 +1,13 @@
 #include "control_system.h"
 
 float HandleSimulationControl( SimulationControl &simulationControl,
-			       float dtMeasured, Particles& particles, AppState* as) {
+			       float dtMeasured, SimThread& sim, AppState* as) {
   float dtToSim = 0.0f;
   
   if (simulationControl.isReset) {
-    particles.Reset(smoothingRadius, as);
+    sim.Post([as](Particles& particles, std::vector<SDFCollider>&) {
+      particles.Reset(smoothingRadius, as);
+    });
     simulationControl.isReset = false;
     simulationControl.isPaused = false;
     simulationControl.isStepping = false;
@@ -16,6 +18,8 @@ float HandleSimulationControl( SimulationControl &simulationControl,
   } else if (simulationControl.isStepping) {
     dtToSim = 1.0f / 60.0f;
     simulationControl.isStepping = false;
+    if (sim.Threaded())
+      sim.RequestStep();
   }
 
   return dtToSim;
@@ -8,10 +8,10 @@
 
 #include "../app/simulation_control.h"
 #include "../app/input_state.h"
-#include "../particles.h"
+#include "../sim_thread.h"
 
 float HandleSimulationControl(SimulationControl &simulationControl, 
-			      float dtMeasured, Particles& particles, AppState* as);
+			      float dtMeasured, SimThread& sim, AppState* as);
 
 
 
@@ -1,7 +1,59 @@
 #include "hud_system.h"
 #include "objects3d/object_builder.h"
+#include <unordered_map>
 
-void DrawHUD(Particles& particles, SimulationControl& simulationControl,
+// Solver parameters belong to the simulation thread. Each control edits a
+// HUD-side copy, taken on first use, and posts changes through the command
+// queue so they land between two steps.
+template<typename T>
+static T& UiCopy(T& param) {
+  static std::unordered_map<const void*, T> copies;
+  return copies.try_emplace(&param, param).first->second;
+}
+
+template<typename T>
+static void PostParam(SimThread& sim, T& param, T value) {
+  sim.Post([&param, value](Particles&, std::vector<SDFCollider>&) { param = value; });
+}
+
+// For values set by the app rather than by the control itself
+template<typename T>
+static void SetParam(SimThread& sim, T& param, T value) {
+  UiCopy(param) = value;
+  PostParam(sim, param, value);
+}
+
+static bool SimSliderFloat(SimThread& sim, const char* label, float& param, float lo, float hi) {
+  float& ui = UiCopy(param);
+  if (!ImGui::SliderFloat(label, &ui, lo, hi)) return false;
+  PostParam(sim, param, ui);
+  return true;
+}
+
+static bool SimSliderInt(SimThread& sim, const char* label, int& param, int lo, int hi) {
+  int& ui = UiCopy(param);
+  if (!ImGui::SliderInt(label, &ui, lo, hi)) return false;
+  PostParam(sim, param, ui);
+  return true;
+}
+
+static bool SimCheckbox(SimThread& sim, const char* label, bool& param) {
+  bool& ui = UiCopy(param);
+  if (!ImGui::Checkbox(label, &ui)) return false;
+  PostParam(sim, param, ui);
+  return true;
+}
+
+void LoadDefaultScene(SimThread& sim, EditorState& editorState) {
+  const TricklerSettings trickler = loadDefaultScene(editorState);
+  SetParam(sim, tricklerMode,      trickler.mode);
+  SetParam(sim, tricklerOriginX,   trickler.originX);
+  SetParam(sim, tricklerOriginY,   trickler.originY);
+  SetParam(sim, tricklerOriginZ,   trickler.originZ);
+  SetParam(sim, tricklerSpawnRate, trickler.spawnRate);
+}
+
+void DrawHUD(SimThread& sim, const SimSnapshot& snapshot, SimulationControl& simulationControl,
              EditorState& editorState, AppState* as, float dt) {
 
   ImGui_ImplOpenGL3_NewFrame();
@@ -18,6 +70,7 @@ void DrawHUD(Particles& particles, SimulationControl& simulationControl,
     ImGui::Begin("##hud", nullptr, flags);
 
     ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+    ImGui::Text("Sim step: %.2f ms%s", snapshot.stepMs, sim.Threaded() ? " (own thread)" : "");
     ImGui::Text("[ESC] HUD  [Space] Pause  [Ctrl+R] Reset");
     ImGui::Separator();
 
@@ -47,10 +100,10 @@ void DrawHUD(Particles& particles, SimulationControl& simulationControl,
     // -----------------------------------------------------------------------
     if (ImGui::CollapsingHeader("Cell Editor", ImGuiTreeNodeFlags_DefaultOpen)) {
       GridState&   g  = editorState.grid;
-      CellFeature& cf = g.GetCell(g.selX, g.selY, g.selZ);
+      const CellFeature& cf = g.GetCell(g.selX, g.selY, g.selZ);
 
       static const char* featureNames[] = {
-	"Empty", "Ramp", "Straight Channel", "L Channel" 
+	"Empty", "Ramp", "Straight Channel", "L Channel", "Mesh"
       };
       static const char* orientNames[] = {
 	"North", "East", "South", "West"
@@ -109,12 +162,12 @@ void DrawHUD(Particles& particles, SimulationControl& simulationControl,
     // -----------------------------------------------------------------------
     if (ImGui::CollapsingHeader("Scene Controls")) {
       if (ImGui::Button("Load Tutorial Machine"))
-	loadDefaultScene(editorState, as);
+	LoadDefaultScene(sim, editorState);
       ImGui::SameLine();
       if (ImGui::Button("Clear"))
-	clearScene(editorState, as);
+	clearScene(editorState);
       ImGui::Checkbox("Reset Scene on R", &editorState.resetObjectsOnR);
-      //ImGui::Text("Collision objects: %d", (int)editorState.objects.size()); //todo: fix this
+      ImGui::Text("Collision objects: %d", (int)editorState.grid.cells.size());
     }
 
     // -----------------------------------------------------------------------
@@ -123,22 +176,24 @@ void DrawHUD(Particles& particles, SimulationControl& simulationControl,
     if (ImGui::CollapsingHeader("Appearance")) {
       if (simulationControl.isPaused) {
 	bool changed = false;
-	int nPending = particles.numParticles;
+	int nPending = snapshot.numParticles;
 	changed |= ImGui::SliderInt("Particles", &nPending, 10, 60000);
-	changed |= ImGui::SliderFloat("Spacing",  &initSpacing,  0.01f, 0.2f);
-	changed |= ImGui::SliderFloat("Offset X", &initOffsetX, -0.5f, 0.5f);
-	changed |= ImGui::SliderFloat("Offset Y", &initOffsetY, -0.5f, 0.5f);
-	changed |= ImGui::SliderFloat("Offset Z", &initOffsetZ, -0.5f, 0.5f);
+	changed |= SimSliderFloat(sim, "Spacing",  initSpacing,  0.01f, 0.2f);
+	changed |= SimSliderFloat(sim, "Offset X", initOffsetX, -0.5f, 0.5f);
+	changed |= SimSliderFloat(sim, "Offset Y", initOffsetY, -0.5f, 0.5f);
+	changed |= SimSliderFloat(sim, "Offset Z", initOffsetZ, -0.5f, 0.5f);
 	if (changed)
-	  particles.ResizeParticles(nPending, smoothingRadius,
-				    initSpacing, initOffsetX, initOffsetY, initOffsetZ, as);
+	  sim.Post([nPending, as](Particles& particles, std::vector<SDFCollider>&) {
+	    particles.ResizeParticles(nPending, smoothingRadius,
+				      initSpacing, initOffsetX, initOffsetY, initOffsetZ, as);
+	  });
       } else {
-	int nDisplay = particles.numParticles;
+	int nDisplay = snapshot.numParticles;
 	ImGui::BeginDisabled();
 	ImGui::SliderInt("Particles", &nDisplay, 1000, 60000);
-	ImGui::SliderFloat("Pos X",   &initOffsetX, -1.0f, 1.0f);
-	ImGui::SliderFloat("Pos Y",   &initOffsetY, -1.0f, 1.0f);
-	ImGui::SliderFloat("Spacing", &initSpacing,  0.001f, 0.1f);
+	ImGui::SliderFloat("Pos X",   &UiCopy(initOffsetX), -1.0f, 1.0f);
+	ImGui::SliderFloat("Pos Y",   &UiCopy(initOffsetY), -1.0f, 1.0f);
+	ImGui::SliderFloat("Spacing", &UiCopy(initSpacing),  0.001f, 0.1f);
 	ImGui::EndDisabled();
       }
       ImGui::SliderFloat("Particle Size", &radiusLogical, 1.0f, 50.0f);
@@ -148,44 +203,157 @@ void DrawHUD(Particles& particles, SimulationControl& simulationControl,
     // Physics
     // -----------------------------------------------------------------------
     if (ImGui::CollapsingHeader("Physics")) {
-      ImGui::SliderFloat("Smoothing Radius",   &smoothingRadius,   0.01f, 1.0f);
-      ImGui::SliderFloat("Relaxation Factor",  &relaxation,     1000.0f, 50000.0f);
-      ImGui::SliderFloat("Gravity",            &gravity,          -10.0f, 10.0f);
-      ImGui::SliderFloat("Scorr Coefficient",  &scorrCoefficient, 0.000001f, 0.00005f);
-      ImGui::SliderFloat("Viscosity",          &xsphC,             0.01f, 1.0f);
-      ImGui::SliderFloat("Vorticity",          &vorticityEpsilon,  0.0f, 20000.0f);
-      ImGui::SliderInt("Solver Iterations",    &numIterations,     1, 20);
+      SimSliderFloat(sim, "Smoothing Radius",   smoothingRadius,   0.01f, 1.0f);
+      SimSliderFloat(sim, "Relaxation Factor",  relaxation,     1000.0f, 50000.0f);
+      SimSliderFloat(sim, "Gravity",            gravity,          -10.0f, 10.0f);
+      SimSliderFloat(sim, "Scorr Coefficient",  scorrCoefficient, 0.000001f, 0.00005f);
+      SimSliderFloat(sim, "Viscosity",          xsphC,             0.01f, 1.0f);
+      SimSliderFloat(sim, "Vorticity",          vorticityEpsilon,  0.0f, 20000.0f);
+      SimSliderInt(sim, "Solver Iterations",    numIterations,     1, 20);
+      SimCheckbox(sim, "Jacobi solver (deterministic)", jacobiSolver);
     }
 
     // -----------------------------------------------------------------------
     // Mouse
     // -----------------------------------------------------------------------
     if (ImGui::CollapsingHeader("Mouse")) {
+      // strengths are read by the mouse raycast on this thread
       ImGui::SliderFloat("Push Strength", &pushStrength, -100.0f, 0.0f);
       ImGui::SliderFloat("Pull Strength", &pullStrength,   0.0f, 100.0f);
-      ImGui::SliderFloat("Push Radius",   &pushRadius,     0.0f, 1.0f);
-      ImGui::SliderFloat("Pull Radius",   &pullRadius,     0.0f, 1.0f);
+      SimSliderFloat(sim, "Push Radius",   pushRadius,     0.0f, 1.0f);
+      SimSliderFloat(sim, "Pull Radius",   pullRadius,     0.0f, 1.0f);
     }
 
     // -----------------------------------------------------------------------
     // Trickler
     // -----------------------------------------------------------------------
     if (ImGui::CollapsingHeader("Trickler")) {
-      bool prevMode = tricklerMode;
-      ImGui::Checkbox("Trickler Mode", &tricklerMode);
-      if (tricklerMode && !prevMode) {
-	particles.ResetTrickler();
-      } else if (!tricklerMode && prevMode) {
-	particles.activeParticles = particles.numParticles;
+      if (SimCheckbox(sim, "Trickler Mode", tricklerMode)) {
+	sim.Post([](Particles& particles, std::vector<SDFCollider>&) {
+	  if (tricklerMode)
+	    particles.ResetTrickler();
+	  else
+	    particles.activeParticles = particles.numParticles;
+	});
+      }
+      if (UiCopy(tricklerMode)) {
+	SimSliderFloat(sim, "Spawn Rate (p/s)", tricklerSpawnRate, 0.1f, 1000.0f);
+	SimSliderFloat(sim, "Spread", tricklerSpread, 0.0f, 0.2f);
+	SimSliderFloat(sim, "Origin X", tricklerOriginX, -1.0f, 1.0f);
+	SimSliderFloat(sim, "Origin Y", tricklerOriginY, -1.0f, 1.0f);
+	SimSliderFloat(sim, "Origin Z", tricklerOriginZ, -1.0f, 1.0f);
+	ImGui::Text("Active: %d / %d", snapshot.activeParticles, snapshot.numParticles);
       }
-      if (tricklerMode) {
-	ImGui::SliderFloat("Spawn Rate (p/s)", &tricklerSpawnRate, 0.1f, 1000.0f);
-	ImGui::SliderFloat("Spread", &tricklerSpread, 0.0f, 0.2f);
-	ImGui::SliderFloat("Origin X", &tricklerOriginX, -1.0f, 1.0f);
-	ImGui::SliderFloat("Origin Y", &tricklerOriginY, -1.0f, 1.0f);
-	ImGui::SliderFloat("Origin Z", &tricklerOriginZ, -1.0f, 1.0f);
-	ImGui::Text("Active: %d / %d", particles.activeParticles, particles.numParticles);
+    }
+
+    // -----------------------------------------------------------------------
+    // Stats
+    // -----------------------------------------------------------------------
+    if (ImGui::CollapsingHeader("Stats")) {
+#ifdef USE_CUDA
+      ImGui::Text("Neighbour slab (GPU): %.1f MB",
+		  snapshot.numParticles * MAX_NEIGHBOURS * sizeof(int) / (1024.0f * 1024.0f));
+#else
+      int pairs = snapshot.neighbourPairs;
+      ImGui::Text("Neighbour lists: %.2f MB", snapshot.neighbourBytes / (1024.0f * 1024.0f));
+      ImGui::Text("Neighbour pairs: %d (%.1f / particle)", pairs,
+		  snapshot.activeParticles > 0 ? (float)pairs / snapshot.activeParticles : 0.0f);
+      SimCheckbox(sim, "Verlet lists", verletLists);
+      if (UiCopy(verletLists)) {
+	SimCheckbox(sim, "Auto-tune skin", skinAutoTune);
+	float skinFrac = snapshot.skinRadius / UiCopy(smoothingRadius);
+	if (ImGui::SliderFloat("Skin / h", &skinFrac, SKIN_MIN_FRACTION, SKIN_MAX_FRACTION))
+	  sim.Post([skinFrac](Particles& particles, std::vector<SDFCollider>&) {
+	    particles.skinRadius = skinFrac * smoothingRadius;
+	  });
+      }
+      ImGui::Text("Rebuild rate: %.2f / frame", snapshot.rebuildRate);
+      static const char* kernelNames[] = {"auto", "scalar", "avx2", "avx512"};
+      int kernelIdx = (int)UiCopy(kernelFamily);
+      if (ImGui::Combo("Kernels", &kernelIdx, kernelNames, IM_ARRAYSIZE(kernelNames))) {
+	SetParam(sim, kernelFamily, (KernelFamily)kernelIdx);
+      }
+      ImGui::SameLine();
+      ImGui::TextDisabled("(%s)", KernelFamilyName(snapshot.activeKernelFamily));
+      // the SIMD kernels recompute every pair and take precedence
+      const bool simdKernels = snapshot.activeKernelFamily != KernelFamily::SCALAR;
+      ImGui::BeginDisabled(simdKernels);
+      SimCheckbox(sim, "Pair cache", usePairCache);
+      ImGui::EndDisabled();
+      if (simdKernels) {
+	ImGui::SameLine();
+	ImGui::TextDisabled("(inactive: SIMD kernels)");
+      } else if (UiCopy(usePairCache)) {
+	ImGui::Text("Pair cache: %.2f MB", snapshot.pairCacheBytes / (1024.0f * 1024.0f));
+      }
+      SimSliderInt(sim, "SDF volume res (0 = analytic)", sdfVolumeResolution, 0, 256);
+      SimCheckbox(sim, "Bucketed colliders", bucketedColliders);
+      static const char* scheduleNames[] = {"every iteration", "last iteration", "end of step"};
+      int scheduleIdx = (int)UiCopy(collisionSchedule);
+      if (ImGui::Combo("Collisions", &scheduleIdx, scheduleNames, IM_ARRAYSIZE(scheduleNames))) {
+	SetParam(sim, collisionSchedule, (CollisionSchedule)scheduleIdx);
+      }
+      SimCheckbox(sim, "Collision cache", collisionCache);
+      if (UiCopy(collisionCache))
+	ImGui::Text("Collision tests skipped: %.1f%%", snapshot.collisionSkipRate * 100.0f);
+      if (snapshot.sdfVolumeBytes > 0) {
+	ImGui::Text("SDF volumes: %.2f MB, max error %.4f", snapshot.sdfVolumeBytes / (1024.0f * 1024.0f),
+		    snapshot.sdfVolumeError);
+      } else {
+	static const char* gradientNames[] = {"analytic", "finite difference"};
+	int gradientIdx = (int)UiCopy(sdfGradientMode);
+	if (ImGui::Combo("SDF gradient", &gradientIdx, gradientNames, IM_ARRAYSIZE(gradientNames))) {
+	  SetParam(sim, sdfGradientMode, (SDFGradient)gradientIdx);
+	}
+      }
+      // the second backend is TBB or std::execution depending on the build
+#ifdef USE_TBB
+      static const char* backendNames[] = {"pool", "tbb"};
+      const ParallelBackend other = ParallelBackend::TBB;
+#else
+      static const char* backendNames[] = {"pool", "std"};
+      const ParallelBackend other = ParallelBackend::STD;
+#endif
+      ParallelBackend& backend = UiCopy(parallelBackend);
+      int backendIdx = backend == other ? 1 : 0;
+      if (ImGui::Combo("Parallel", &backendIdx, backendNames, IM_ARRAYSIZE(backendNames))) {
+	backend = backendIdx == 1 ? other : ParallelBackend::POOL;
+	PostParam(sim, parallelBackend, backend);
+      }
+      if (backend == ParallelBackend::POOL) {
+	SimSliderInt(sim, "Threads (0 = all)", poolThreads, 0,
+		     (int)std::thread::hardware_concurrency());
+	SimCheckbox(sim, "Pin threads", pinThreads);
+      }
+      SimSliderInt(sim, "Grain", parallelGrain, 16, 4096);
+#endif
+      // drawn on this thread, so no round trip through the simulation
+      const RenderStats& render = as->renderStats;
+      ImGui::Checkbox("Persistent instance ring", &persistentInstances);
+      ImGui::Text("Instance upload: %.2f MB (%s), %d stalls",
+		  render.instanceBytes / (1024.0f * 1024.0f),
+		  render.persistentInstances ? "persistent" : "mapped per frame", render.instanceStalls);
+      static const char* spriteNames[] = {"quad + discard", "polygon (early-Z)"};
+      int spriteIdx = (int)particleSprite;
+      if (ImGui::Combo("Particle sprite", &spriteIdx, spriteNames, IM_ARRAYSIZE(spriteNames)))
+	particleSprite = (ParticleSprite)spriteIdx;
+      // samples passed are counted after the depth test whether or not it
+      // ran early, so only shader invocations show the early-Z saving
+      const double pixels = render.framePixels ? (double)render.framePixels : 1.0;
+      if (render.shadedCounted) {
+	ImGui::Text("Particle pass: %.2f ms GPU, %.2f M fragments shaded (%.2f per pixel)",
+		    render.particlePassMs, render.particleShaded / 1e6, render.particleShaded / pixels);
+	ImGui::Text("  %.2f M depth-passing fragments (%.2f per pixel)",
+		    render.particleSamples / 1e6, render.particleSamples / pixels);
+      } else {
+	ImGui::Text("Particle pass: %.2f ms GPU, %.2f M depth-passing fragments (%.2f per pixel)",
+		    render.particlePassMs, render.particleSamples / 1e6, render.particleSamples / pixels);
+	ImGui::TextDisabled("No shader invocation count; compare GPU ms for the early-Z saving.");
       }
+      ImGui::Checkbox("Cull particle cells", &cullParticleCells);
+      ImGui::SliderFloat("LOD distance (0 = off)", &particleLodDistance, 0.0f, 10.0f);
+      ImGui::Text("Particles drawn: %d + %d cell splats, %d culled (%d cells)",
+		  render.drawnParticles, render.splatCells, render.culledParticles, render.culledCells);
     }
 
     ImGui::End();
@@ -3,8 +3,13 @@
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
-#include "../particles.h"
+#include "../sim_thread.h"
 #include "../app/simulation_control.h"
 #include "objects3d/editor_state.h"
 
-void DrawHUD(Particles& particles, SimulationControl& simulationControl, EditorState& editorState, AppState* as, float dt);
+// Loads the tutorial machine and posts its trickler settings to the
+// simulation, keeping the HUD's copies of them in step
+void LoadDefaultScene(SimThread& sim, EditorState& editorState);
+
+void DrawHUD(SimThread& sim, const SimSnapshot& snapshot, SimulationControl& simulationControl,
+             EditorState& editorState, AppState* as, float dt);
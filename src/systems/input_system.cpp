@@ -4,7 +4,7 @@
 #include <string>
 
 static const char *kFeatureNames[] = {"Empty", "Ramp", "Straight Channel",
-                                      "L Channel"};
+                                      "L Channel", "Mesh"};
 constexpr int FEATURE_COUNT = std::size(kFeatureNames);
 static const char* kOrientNames[]  = { "North", "East", "South", "West" };
 
@@ -67,7 +67,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                 if (!es->previewActive) startPreview(grid, *es);
                 int n = (((int)es->previewCell.feature + delta) % FEATURE_COUNT + FEATURE_COUNT) % FEATURE_COUNT;
                 es->previewCell.feature = static_cast<Feature>(n);
-                addPreviewObject(*es, grid.CellIndex(grid.selX, grid.selY, grid.selZ));
+                addPreviewObject(*es);
                 es->statusMsg   = std::string("Preview: ") + kFeatureNames[n]
                                   + "  [Enter]=Place  [Esc]=Cancel";
                 es->statusTimer = 4.0f;
@@ -79,7 +79,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                 if (!es->previewActive) startPreview(grid, *es);
                 int n = ((int)es->previewCell.facing + 1 + 4) % 4;
                 es->previewCell.facing = static_cast<Orientation>(n);
-                addPreviewObject(*es, grid.CellIndex(grid.selX, grid.selY, grid.selZ));
+                addPreviewObject(*es);
                 es->statusMsg   = std::string("Facing: ") + kOrientNames[n]
                                   + "  [Enter]=Place  [Esc]=Cancel";
                 es->statusTimer = 4.0f;
@@ -91,7 +91,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                 if (!es->previewActive) startPreview(grid, *es);
                 int n = ((int)es->previewCell.facing - 1 + 4) % 4;
                 es->previewCell.facing = static_cast<Orientation>(n);
-                addPreviewObject(*es, grid.CellIndex(grid.selX, grid.selY, grid.selZ));
+                addPreviewObject(*es);
                 es->statusMsg   = std::string("Facing: ") + kOrientNames[n]
                                   + "  [Enter]=Place  [Esc]=Cancel";
                 es->statusTimer = 4.0f;
@@ -104,7 +104,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                 if (!es->previewActive) startPreview(grid, *es);
                 int v = std::max(0, std::min(4, es->previewCell.variant + delta));
                 es->previewCell.variant = v;
-                addPreviewObject(*es, grid.CellIndex(grid.selX, grid.selY, grid.selZ));
+                addPreviewObject(*es);
                 es->statusMsg   = "Preview: variant " + std::to_string(v)
                                   + "  [Enter]=Place  [Esc]=Cancel";
                 es->statusTimer = 4.0f;
@@ -116,7 +116,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                 if (es->previewActive) {
                     int px = es->previewX, py = es->previewY, pz = es->previewZ;
                     int fn = (int)es->previewCell.feature;
-                    commitPreview(grid, *es, appState);
+                    commitPreview(*es);
                     es->statusMsg   = std::string("Placed ") + kFeatureNames[fn]
                                       + " at (" + std::to_string(px) + ","
                                       + std::to_string(py) + "," + std::to_string(pz) + ").";
@@ -128,7 +128,7 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
             // Delete / Backspace: cancel any preview, then clear the cell
             if (key == GLFW_KEY_DELETE || key == GLFW_KEY_BACKSPACE) {
 	      if (es->previewActive) cancelPreview(grid, *es);
-	      clearCell(grid, *es, appState);
+	      clearCell(grid, *es);
                 es->statusMsg   = "Cell cleared.";
                 es->statusTimer = 2.0f;
                 return;
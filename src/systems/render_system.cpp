@@ -1,37 +1,176 @@
 #include "render_system.h"
+#include "../particle_config.h"
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <cstring>
+
+// Planes (a, b, c, d) of the view frustum, inside where a x + b y + c z + d >= 0,
+// read off the rows of projection * view
+struct Frustum {
+  float planes[6][4];
+};
+
+static Frustum ExtractFrustum(const Mat4& viewProjection)
+{
+  const float* m = viewProjection.entries;   // column-major
+  Frustum f;
+  for (int p = 0; p < 6; ++p) {
+    const int   axis = p / 2;
+    const float sign = p % 2 == 0 ? 1.0f : -1.0f;
+    for (int c = 0; c < 4; ++c)
+      f.planes[p][c] = m[c * 4 + 3] + sign * m[c * 4 + axis];
+  }
+  return f;
+}
+
+// False only when the box lies wholly outside one plane
+static bool BoxInFrustum(const Frustum& f, const Vec3& lo, const Vec3& hi)
+{
+  for (const float* p : f.planes) {
+    const float x = p[0] >= 0.0f ? hi.x : lo.x;
+    const float y = p[1] >= 0.0f ? hi.y : lo.y;
+    const float z = p[2] >= 0.0f ? hi.z : lo.z;
+    if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+static Vec3 InstancePosition(const PackedInstance& q)
+{
+  const float s = 2.0f / 65535.0f;
+  return Vec3{q.x * s - 1.0f, q.y * s - 1.0f, q.z * s - 1.0f};
+}
+
+// Writes the instances of the grid cells in view into the ring, near cells'
+// particles first and then one splat per far cell; reach is how far a drawn
+// quad can stick out of its cell's box
+static void WriteVisibleInstances(const SimSnapshot& snapshot, const Mat4& proj,
+                                  const Mat4& view, float reach, ParticleMesh& mesh,
+                                  RenderStats& stats, int& nearCount, int& splatCount)
+{
+  static std::vector<PackedInstance> splats;
+  splats.clear();
+  nearCount = 0;
+  stats.culledParticles = stats.culledCells = 0;
+
+  const int n = snapshot.activeParticles;
+  PackedInstance* out = mesh.BeginInstances(n);
+  if (!out) {
+    mesh.EndInstances(0);
+    splatCount = 0;
+    return;
+  }
+
+  const bool lod = particleLodDistance > 0.0f;
+  if (snapshot.instanceCells.empty() || (!cullParticleCells && !lod)) {
+    std::memcpy(out, snapshot.instances.data(), n * sizeof(PackedInstance));
+    nearCount = n;
+  } else {
+    const Frustum frustum = ExtractFrustum(Mat4Multiply(proj, view));
+    const Vec3 margin{reach, reach, reach};
+    const float lod2 = particleLodDistance * particleLodDistance;
+    // consecutive near cells are one run in the snapshot, copied at once
+    int runFirst = 0, runCount = 0;
+    auto flush = [&] {
+      std::memcpy(out + nearCount, snapshot.instances.data() + runFirst,
+                  runCount * sizeof(PackedInstance));
+      nearCount += runCount;
+      runCount = 0;
+    };
+    for (const InstanceCell& cell : snapshot.instanceCells) {
+      const Vec3 lo = InstancePosition(cell.lo), hi = InstancePosition(cell.hi);
+      if (cullParticleCells && !BoxInFrustum(frustum, lo - margin, hi + margin)) {
+        stats.culledParticles += cell.count;
+        ++stats.culledCells;
+        continue;
+      }
+      if (lod && cell.count > 1) {
+        Vec3 centre = TransformPoint(view, (lo + hi) * 0.5f);
+        if (centre.Dot(centre) > lod2) {
+          splats.push_back(cell.splat);
+          continue;
+        }
+      }
+      if (runCount > 0 && runFirst + runCount != cell.first)
+        flush();
+      if (runCount == 0)
+        runFirst = cell.first;
+      runCount += cell.count;
+    }
+    if (runCount > 0)
+      flush();
+  }
+
+  std::memcpy(out + nearCount, splats.data(), splats.size() * sizeof(PackedInstance));
+  splatCount = (int)splats.size();
+  mesh.EndInstances(nearCount + splatCount);
+}
+
+
 void Render(const CameraState &cameraState, const Viewport &viewport,
-            Particles &particles, ParticleMesh &particleMesh,
-            unsigned int particleShader,
+            const SimSnapshot &snapshot, ParticleMesh &particleMesh,
+            unsigned int particleShader, unsigned int impostorShader,
             const std::vector<SceneObject>& sceneObjects,
             float radiusLogical, float xScale, AppState* as) {
 
-  int n = particles.activeParticles;
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  glUseProgram(particleShader);
+  // the polygon sprite has its own shader so the quad's discard does not
+  // cost it early depth testing
+  const unsigned int shader = particleSprite == ParticleSprite::POLYGON ? impostorShader
+                                                                        : particleShader;
+  glUseProgram(shader);
    
   Mat4 proj = Perspective(45.0f * PI / 180.0f, (float)viewport.screenWidth / viewport.screenHeight,
 			  0.1f, 100.0f);
    
-  glUniformMatrix4fv(glGetUniformLocation(particleShader, "projection"), 1, GL_FALSE, proj.entries);
-  glUniformMatrix4fv(glGetUniformLocation(particleShader, "view"), 1, GL_FALSE,
+  glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, proj.entries);
+  glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, GL_FALSE,
                      cameraState.view.entries);
 
   float fov = 45.0f * PI / 180.0f;
   float viewRadius = (radiusLogical / viewport.screenHeight) * 2.0f * tan(fov / 2.0f);
-  glUniform1f(glGetUniformLocation(particleShader, "radius"), viewRadius);
+  glUniform1f(glGetUniformLocation(shader, "radius"), viewRadius);
 
-  glUniform3f(glGetUniformLocation(particleShader, "lightDir"), 0.6f, 0.8f, 1.0f);
+  glUniform3f(glGetUniformLocation(shader, "lightDir"), 0.6f, 0.8f, 1.0f);
 
+  RenderStats& stats = as->renderStats;
 #ifdef USE_CUDA
+  // the device arrays are not in grid order; everything is drawn
+  const int n = snapshot.activeParticles;
   particleMesh.gpuUpdateInstanceData(as->cudaBuffers->positions_d, as->cudaBuffers->velocities_d, n);
+  particleMesh.Pass().Begin();
+  particleMesh.DrawInstanced(0, n);
+  particleMesh.Pass().End();
+  stats.drawnParticles  = n;
+  stats.splatCells      = 0;
+  stats.culledParticles = stats.culledCells = 0;
 #else
-  particleMesh.UpdateInstanceData(particles.positions, particles.velocities);
+  // a splat stands in for a whole cell, and is the widest quad drawn
+  const float splatRadius = std::max(viewRadius, 0.5f * snapshot.instanceCellSize);
+  int nearCount = 0, splatCount = 0;
+  WriteVisibleInstances(snapshot, proj, cameraState.view, splatRadius, particleMesh, stats,
+                        nearCount, splatCount);
+  particleMesh.Pass().Begin();
+  particleMesh.DrawInstanced(0, nearCount);
+  if (splatCount > 0) {
+    glUniform1f(glGetUniformLocation(shader, "radius"), splatRadius);
+    particleMesh.DrawInstanced(nearCount, splatCount);
+  }
+  particleMesh.Pass().End();
+  stats.drawnParticles = nearCount;
+  stats.splatCells     = splatCount;
 #endif
-
-  particleMesh.DrawInstanced(n);
+  stats.instanceBytes       = particleMesh.UploadBytes();
+  stats.persistentInstances = particleMesh.Instances().Persistent();
+  stats.instanceStalls      = particleMesh.Instances().Stalls();
+  stats.particlePassMs      = particleMesh.Pass().Milliseconds();
+  stats.particleSamples     = particleMesh.Pass().Samples();
+  stats.particleShaded      = particleMesh.Pass().Invocations();
+  stats.shadedCounted       = particleMesh.Pass().HasInvocations();
+  stats.framePixels         = (uint64_t)viewport.screenWidth * viewport.screenHeight;
 
   for (const auto& obj : sceneObjects) {
     if (!obj.visible) continue;
@@ -1,14 +1,14 @@
 #pragma once
 
 #include "camera_system.h"
-#include "../particles.h"
+#include "../sim_thread.h"
 #include "../particle_mesh.h"
 #include "../app/viewport.h"
 #include "../line_renderer.h"
 #include "../app/scene_manager.h"
 
 void Render(const CameraState &cameraState, const Viewport &viewport,
-            Particles &particles, ParticleMesh &particleMesh,
-            unsigned int particleShader,
+            const SimSnapshot &snapshot, ParticleMesh &particleMesh,
+            unsigned int particleShader, unsigned int impostorShader,
             const std::vector<SceneObject>& sceneObjects,
             float radiusLogical, float xScale, AppState* as);
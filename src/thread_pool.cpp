@@ -0,0 +1,211 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define POOL_PAUSE() _mm_pause()
+#else
+#define POOL_PAUSE() std::this_thread::yield()
+#endif
+
+// Spins before a worker falls back to sleeping on the epoch
+static constexpr int POOL_SPIN_ITERATIONS = 4096;
+
+// Set on workers and on the caller while it runs a region; a ParallelFor
+// issued from inside a loop body runs inline instead of re-entering the pool
+static thread_local bool insideRegion = false;
+
+static uint64_t PackRange(uint32_t begin, uint32_t end)
+{
+  return ((uint64_t)end << 32) | begin;
+}
+
+static void UnpackRange(uint64_t packed, int& begin, int& end)
+{
+  begin = (int)(uint32_t)packed;
+  end   = (int)(uint32_t)(packed >> 32);
+}
+
+static void PinToCore(std::thread& thread, int core)
+{
+#if defined(_WIN32)
+  SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (core % 64));
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+  (void)thread;   // macOS has no hard affinity, only hints
+  (void)core;
+#endif
+}
+
+ThreadPool& GlobalThreadPool()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::~ThreadPool()
+{
+  Stop();
+}
+
+void ThreadPool::Configure(int threads, bool pinThreads)
+{
+  const int hw = std::max(1, (int)std::thread::hardware_concurrency());
+  if (threads <= 0)
+    threads = hw;
+  if (threads == ThreadCount() && pinThreads == pinned_)
+    return;
+
+  Stop();
+  stop_.store(false);
+  slots_  = std::vector<Slot>(threads);
+  pinned_ = pinThreads;
+  // workers start from the current epoch so they cannot miss the first region
+  const uint32_t epoch = epoch_.load(std::memory_order_acquire);
+  for (int p = 1; p < threads; ++p) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this, p, epoch);
+    if (pinThreads)
+      PinToCore(workers_.back(), p % hw);
+  }
+}
+
+void ThreadPool::Stop()
+{
+  if (workers_.empty()) return;
+  stop_.store(true, std::memory_order_release);
+  epoch_.fetch_add(1, std::memory_order_release);
+  epoch_.notify_all();
+  for (std::thread& t : workers_)
+    t.join();
+  workers_.clear();
+}
+
+void ThreadPool::Run(int n, int grain, ChunkFn body, void* ctx)
+{
+  if (n <= 0) return;
+  if (slots_.empty())
+    Configure(0, false);
+
+  const int participants = ThreadCount();
+  grain = std::max(1, grain);
+  if (participants == 1 || n <= grain || insideRegion) {
+    body(ctx, 0, n, 0);
+    return;
+  }
+
+  body_  = body;
+  ctx_   = ctx;
+  grain_ = grain;
+  for (int p = 0; p < participants; ++p) {
+    uint32_t begin = (uint32_t)((int64_t)n * p / participants);
+    uint32_t end   = (uint32_t)((int64_t)n * (p + 1) / participants);
+    slots_[p].range.store(PackRange(begin, end), std::memory_order_relaxed);
+  }
+  remaining_.store(n, std::memory_order_relaxed);
+  pending_.store(participants - 1, std::memory_order_relaxed);
+  epoch_.fetch_add(1, std::memory_order_release);
+  epoch_.notify_all();
+
+  insideRegion = true;
+  Work(0);
+  insideRegion = false;
+  // workers may still be between their last chunk and checking out; body_
+  // and ctx_ must stay valid until they have
+  while (pending_.load(std::memory_order_acquire) != 0)
+    POOL_PAUSE();
+}
+
+void ThreadPool::Work(int participant)
+{
+  int spins = 0;
+  for (;;) {
+    int begin, end;
+    if (TakeFront(participant, begin, end)) {
+      body_(ctx_, begin, end, participant);
+      remaining_.fetch_sub(end - begin, std::memory_order_acq_rel);
+      continue;
+    }
+    if (remaining_.load(std::memory_order_acquire) == 0)
+      return;
+    if (Steal(participant))
+      continue;
+    if (++spins % 64 == 0)
+      std::this_thread::yield();
+    else
+      POOL_PAUSE();
+  }
+}
+
+bool ThreadPool::TakeFront(int participant, int& begin, int& end)
+{
+  std::atomic<uint64_t>& range = slots_[participant].range;
+  uint64_t packed = range.load(std::memory_order_acquire);
+  for (;;) {
+    UnpackRange(packed, begin, end);
+    if (begin >= end) return false;
+    int take = std::min(end, begin + grain_);
+    if (range.compare_exchange_weak(packed, PackRange(take, end),
+                                    std::memory_order_acq_rel)) {
+      end = take;
+      return true;
+    }
+  }
+}
+
+// Takes the back half of the first non-empty range after our own. Our own
+// slot is empty here, so nobody else is changing it when we store the loot.
+bool ThreadPool::Steal(int participant)
+{
+  const int participants = ThreadCount();
+  for (int o = 1; o < participants; ++o) {
+    std::atomic<uint64_t>& victim = slots_[(participant + o) % participants].range;
+    uint64_t packed = victim.load(std::memory_order_acquire);
+    int begin, end;
+    UnpackRange(packed, begin, end);
+    while (begin < end) {
+      int size = end - begin;
+      int mid  = size > grain_ ? end - size / 2 : begin;
+      if (victim.compare_exchange_weak(packed, PackRange(begin, mid),
+                                       std::memory_order_acq_rel)) {
+        slots_[participant].range.store(PackRange(mid, end), std::memory_order_release);
+        return true;
+      }
+      UnpackRange(packed, begin, end);
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int participant, uint32_t seen)
+{
+  insideRegion = true;
+  for (;;) {
+    uint32_t now = seen;
+    for (int i = 0; i < POOL_SPIN_ITERATIONS && now == seen; ++i) {
+      POOL_PAUSE();
+      now = epoch_.load(std::memory_order_acquire);
+    }
+    if (now == seen) {
+      epoch_.wait(seen, std::memory_order_acquire);
+      now = epoch_.load(std::memory_order_acquire);
+    }
+    seen = now;
+    if (stop_.load(std::memory_order_acquire))
+      return;
+
+    Work(participant);
+    pending_.fetch_sub(1, std::memory_order_release);
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent fork/join pool behind Particles::ParallelFor.
+//
+// The calling thread takes part as participant 0. Each participant owns a
+// [begin, end) range packed into one 64-bit atomic: the owner takes grain
+// sized chunks from the front, idle participants steal half of what is left
+// from the back of someone else's range. Both sides only ever CAS the packed
+// word, so no locks are taken on the hot path. Between regions workers spin
+// briefly and then sleep on an atomic wait.
+class ThreadPool {
+public:
+  ThreadPool() = default;
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // threads <= 0 uses every hardware thread. Restarts the workers only when
+  // something changed, so it is cheap to call every frame.
+  void Configure(int threads, bool pinThreads);
+  int  ThreadCount() const { return (int)slots_.size(); }
+
+  // func(begin, end, participant) over disjoint chunks covering [0, n)
+  template<typename F>
+  void ParallelForChunks(int n, int grain, F&& func) {
+    using Fn = std::remove_reference_t<F>;
+    Run(n, grain, [](void* ctx, int begin, int end, int participant) {
+      (*static_cast<Fn*>(ctx))(begin, end, participant);
+    }, (void*)&func);
+  }
+
+  template<typename F>
+  void ParallelFor(int n, int grain, F&& func) {
+    ParallelForChunks(n, grain, [&](int begin, int end, int) {
+      for (int i = begin; i < end; ++i)
+        func(i);
+    });
+  }
+
+private:
+  using ChunkFn = void (*)(void* ctx, int begin, int end, int participant);
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> range{0};
+  };
+
+  void Run(int n, int grain, ChunkFn body, void* ctx);
+  void Work(int participant);
+  bool TakeFront(int participant, int& begin, int& end);
+  bool Steal(int participant);
+  void WorkerLoop(int participant, uint32_t epoch);
+  void Stop();
+
+  std::vector<Slot>        slots_;
+  std::vector<std::thread> workers_;
+  bool                     pinned_ = false;
+
+  ChunkFn                  body_  = nullptr;
+  void*                    ctx_   = nullptr;
+  int                      grain_ = 1;
+  std::atomic<int>         remaining_{0};  // items not yet processed
+  std::atomic<int>         pending_{0};    // workers still inside the region
+  std::atomic<uint32_t>    epoch_{0};      // bumped to start a region
+  std::atomic<bool>        stop_{false};
+};
+
+// Pool shared by all simulation loops
+ThreadPool& GlobalThreadPool();
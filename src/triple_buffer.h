@@ -0,0 +1,32 @@
+#pragma once
+#include <atomic>
+
+// Single producer / single consumer triple buffer. The producer fills
+// WriteBuffer() and publishes it; the consumer always reads the newest
+// published value. Neither side ever waits for the other: the three slots
+// rotate through one atomic exchange per publish or read.
+template<typename T>
+class TripleBuffer {
+public:
+  T& WriteBuffer() { return slots[back]; }
+
+  void Publish() {
+    back = state.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Newest published value, unchanged until the next Read()
+  const T& Read() {
+    if (state.load(std::memory_order_acquire) & FRESH)
+      front = state.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return slots[front];
+  }
+
+private:
+  static constexpr int INDEX = 3;
+  static constexpr int FRESH = 4;
+
+  T slots[3];
+  int back  = 0;               // producer only
+  int front = 1;               // consumer only
+  std::atomic<int> state{2};   // spare slot, FRESH when not yet read
+};